@@ -0,0 +1,190 @@
+// Microbenchmarks of the config and INI hot paths
+//
+// Build and run with fmake:
+//   fmake -t fmakeBench -execute fmake.props
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "Utils.h"
+#include "CompileCpp.h"
+
+// Count heap allocations
+static std::atomic<uint64_t> allocCount(0);
+
+void* operator new(std::size_t size) {
+    allocCount++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// Keep the optimizer from dropping results
+static volatile size_t sink;
+
+template <typename F>
+static void bench(const char* name, int iterations, F f) {
+    // Warm up
+    f();
+
+    uint64_t allocs = allocCount.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    allocs = allocCount.load() - allocs;
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    std::cout << std::left << std::setw(36) << name << std::right
+        << std::setw(10) << iterations
+        << std::setw(16) << std::fixed << std::setprecision(0) << ns
+        << std::setw(14) << std::setprecision(1) << (double)allocs / iterations << std::endl;
+}
+
+// Tool chain like props with many keys
+static void genProps(const fs::path& file, int keys) {
+    std::ofstream ofs(file);
+    for (int i = 0; i < keys; ++i) {
+        switch (i % 4) {
+            case 0:
+                ofs << "tool" << i << ".defines=[-D@{defines}]" << std::endl;
+                break;
+            case 1:
+                ofs << "tool" << i << ".flags@{release}=-DNDEBUG -O3 @{cppflags}" << std::endl;
+                break;
+            case 2:
+                ofs << "tool" << i << ".comp=@{tool" << i << ".name} -c -fPIC -Wall \\" << std::endl;
+                ofs << "  @{tool" << i << ".flags} -o @{objFile} @{srcFile}" << std::endl;
+                break;
+            default:
+                ofs << "# comment " << i << std::endl;
+                ofs << "tool" << i << ".home=/opt/tool" << i << "/bin/" << std::endl;
+                break;
+        }
+    }
+}
+
+// Build script with many sections
+static void genIni(const fs::path& file, int sections) {
+    std::ofstream ofs(file);
+    for (int i = 0; i < sections; ++i) {
+        ofs << "[pod" << i << "]" << std::endl;
+        ofs << "summary = generated pod " << i << std::endl;
+        ofs << "outType = lib" << std::endl;
+        ofs << "version = 1." << i << std::endl;
+        ofs << "srcDirs = src" << i << "/*" << std::endl;
+        ofs << "incDirs = inc" << i << "/" << std::endl;
+        ofs << "depends = pod" << (i > 0 ? i - 1 : 0) << " 1.0, base 2.0" << std::endl;
+        ofs << "defines = A=1,B=2,\\" << std::endl;
+        ofs << "  C=3" << std::endl;
+        ofs << "gcc.cppflags = -std=c++17" << std::endl;
+        ofs << std::endl;
+    }
+}
+
+// gcc entries of tool_chain.props
+static void addToolChain(std::map<std::string, std::string>& configs) {
+    configs["gcc.defines"] = "[-D@{defines}]";
+    configs["gcc.libDirs"] = "[-L@{libDirs}]";
+    configs["gcc.incDirs"] = "[-I@{incDirs}]";
+    configs["gcc.libNames"] = "[-l@{libNames}]";
+    configs["gcc.objList"] = "[@{objList}]";
+    configs["gcc.flags@{debug}"] = "-D_DEBUG -g";
+    configs["gcc.flags@{release}"] = "-DNDEBUG -O3";
+    configs["gcc.name@{cpp}"] = "g++ @{cppflags}";
+    configs["gcc.name@{c}"] = "gcc @{cflags}";
+    configs["gcc.comp"] = "@{gcc.name} -c -fPIC -Wall @{gcc.flags} @{gcc.defines} @{gcc.incDirs} -o @{objFile} @{srcFile}";
+    configs["cppflags"] = "-std=c++17";
+    configs["cflags"] = "";
+    configs["srcFile"] = "/work/project/src/module/file.cpp";
+    configs["objFile"] = "/work/build/obj-project-gcc-release/src/module/file.cpp.o";
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / "fmake-bench";
+    fs::create_directories(dir);
+    fs::path propsFile = dir / "tool_chain.props";
+    fs::path iniFile = dir / "fmake.props";
+    genProps(propsFile, 5000);
+    genIni(iniFile, 200);
+
+    std::cout << std::left << std::setw(36) << "benchmark" << std::right
+        << std::setw(10) << "iter" << std::setw(16) << "ns/op" << std::setw(14) << "allocs/op" << std::endl;
+
+    bench("readProps 5000 keys", 20, [&]() {
+        sink = Utils::readProps(propsFile).size();
+    });
+
+    bench("readIni 200 sections", 50, [&]() {
+        sink = Utils::readIni(iniFile).size();
+    });
+
+    std::string list;
+    for (int i = 0; i < 1000; ++i) {
+        list += " item" + std::to_string(i) + " ,";
+    }
+    bench("split 1000 items", 1000, [&]() {
+        sink = Utils::split(list, ',').size();
+    });
+
+    // Realistic configs: the big props plus the gcc tool chain
+    std::map<std::string, std::string> base = Utils::readProps(propsFile);
+    addToolChain(base);
+
+    std::map<std::string, std::vector<std::string>> params;
+    for (int i = 0; i < 200; ++i) {
+        params["incDirs"].push_back("/work/deps/pod" + std::to_string(i) + "/include/");
+        params["defines"].push_back("DEF" + std::to_string(i) + "=1");
+    }
+    params["libNames"] = {"a", "b", "c"};
+    params["libDirs"] = {"/work/lib/"};
+    params["objList"] = {"a.o", "b.o"};
+
+    bench("applayMacrosForList 5000 keys", 20, [&]() {
+        auto configs = base;
+        CompileCpp::applayMacrosForList(configs, params);
+        sink = configs.size();
+    });
+
+    std::map<std::string, std::string> configs = base;
+    CompileCpp::applayMacrosForList(configs, params);
+    CompileCpp::selectMacros(configs, "release");
+
+    bench("selectMacros 5000 keys", 100, [&]() {
+        CompileCpp::selectMacros(configs, "cpp");
+        sink = configs.size();
+    });
+
+    bench("applyMacros gcc.comp", 1000, [&]() {
+        sink = CompileCpp::applyMacros(configs["gcc.comp"], configs).size();
+    });
+
+    // Each level refers to the next one
+    std::map<std::string, std::string> nested;
+    for (int i = 0; i < 32; ++i) {
+        nested["m" + std::to_string(i)] = "x" + std::to_string(i) + " @{m" + std::to_string(i + 1) + "} @{m" + std::to_string(i + 1) + "}";
+    }
+    nested["m32"] = "end";
+    bench("applyMacros nested 8 levels", 1000, [&]() {
+        sink = CompileCpp::applyMacros("@{m24}", nested).size();
+    });
+
+    fs::remove_all(dir);
+    return 0;
+}
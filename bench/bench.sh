@@ -0,0 +1,254 @@
+#!/bin/sh
+# Benchmark fmake on a generated workspace
+#
+# Usage: sh bench/bench.sh [options]
+#   -pods N      number of pod scripts (default 4)
+#   -sections N  sections per script (default 2)
+#   -srcs N      sources per section (default 10)
+#   -fanout N    headers included by each source (default 3)
+#   -depth N     length of the depends chain (default 2)
+#   -tree N      directory depth under srcDirs = x/* (default 2)
+#   -dir DIR     workspace directory (default /tmp/fmake-bench)
+#   -out FILE    JSON result file (default bench_result.json)
+#
+# Times full, no-op, single header touch builds and -G generation.
+# The same workspace is built with CMake (Ninja if installed) for comparison.
+
+PODS=4
+SECTIONS=2
+SRCS=10
+FANOUT=3
+DEPTH=2
+TREE=2
+WS=/tmp/fmake-bench
+OUT=bench_result.json
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -pods) PODS=$2; shift ;;
+    -sections) SECTIONS=$2; shift ;;
+    -srcs) SRCS=$2; shift ;;
+    -fanout) FANOUT=$2; shift ;;
+    -depth) DEPTH=$2; shift ;;
+    -tree) TREE=$2; shift ;;
+    -dir) WS=$2; shift ;;
+    -out) OUT=$2; shift ;;
+    *) echo "Unknown option: $1"; exit 1 ;;
+  esac
+  shift
+done
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FMAKE="$ROOT/bin/fmake"
+if [ ! -x "$FMAKE" ]; then
+  echo "Build fmake first: $FMAKE"
+  exit 1
+fi
+
+# Milliseconds since epoch, needs GNU date
+now_ms() {
+  echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Pod name of pod i section j
+pod_name() {
+  echo "p$1s$2"
+}
+
+# Directory of source n in a srcDirs = x/* tree
+tree_dir() {
+  d=""
+  level=0
+  n=$1
+  while [ $level -lt "$TREE" ]; do
+    d="${d}d$(( n % 2 ))/"
+    n=$(( n / 2 ))
+    level=$(( level + 1 ))
+  done
+  echo "$d"
+}
+
+gen_workspace() {
+  rm -rf "$WS"
+  mkdir -p "$WS/repo"
+  i=0
+  while [ $i -lt "$PODS" ]; do
+    pod="$WS/pod$i"
+    mkdir -p "$pod"
+    : > "$pod/fmake.props"
+    j=0
+    while [ $j -lt "$SECTIONS" ]; do
+      name=$(pod_name $i $j)
+      inc="$pod/inc$j"
+      mkdir -p "$inc/$name"
+
+      # Headers, each one includes the first header of the depend
+      h=0
+      while [ $h -lt "$FANOUT" ]; do
+        {
+          echo "#pragma once"
+          if [ $(( i % DEPTH )) -ne 0 ]; then
+            echo "#include \"$(pod_name $(( i - 1 )) 0)/h0.h\""
+          fi
+          echo "#include <string>"
+          echo "#include <vector>"
+          echo "inline int ${name}_h$h(int x) { return x + $h; }"
+        } > "$inc/$name/h$h.h"
+        h=$(( h + 1 ))
+      done
+
+      # Sources in a directory tree
+      s=0
+      while [ $s -lt "$SRCS" ]; do
+        dir="$pod/src$j/$(tree_dir $s)"
+        mkdir -p "$dir"
+        {
+          h=0
+          while [ $h -lt "$FANOUT" ]; do
+            echo "#include \"$name/h$h.h\""
+            h=$(( h + 1 ))
+          done
+          echo "int ${name}_f$s(int x) { std::vector<int> v(x); return (int)v.size() + ${name}_h0(x); }"
+        } > "$dir/f$s.cpp"
+        s=$(( s + 1 ))
+      done
+
+      {
+        echo "[$name]"
+        echo "outType = lib"
+        echo "version = 1.0"
+        echo "srcDirs = src$j/*"
+        echo "incDir = inc$j/"
+        if [ $(( i % DEPTH )) -ne 0 ]; then
+          echo "depends = $(pod_name $(( i - 1 )) 0) 1.0"
+        fi
+        echo ""
+      } >> "$pod/fmake.props"
+      j=$(( j + 1 ))
+    done
+    i=$(( i + 1 ))
+  done
+
+  # Executable depends on section 0 of every pod
+  mkdir -p "$WS/app/src"
+  deps=""
+  {
+    i=0
+    while [ $i -lt "$PODS" ]; do
+      echo "#include \"$(pod_name $i 0)/h0.h\""
+      i=$(( i + 1 ))
+    done
+    echo "int main() { return 0; }"
+  } > "$WS/app/src/main.cpp"
+  i=0
+  while [ $i -lt "$PODS" ]; do
+    [ -n "$deps" ] && deps="$deps, "
+    deps="$deps$(pod_name $i 0) 1.0"
+    i=$(( i + 1 ))
+  done
+  {
+    echo "[app]"
+    echo "outType = exe"
+    echo "srcDirs = src/"
+    echo "depends = $deps"
+  } > "$WS/app/fmake.props"
+}
+
+# Run fmake on all scripts in dependency order, prints elapsed ms
+run_fmake() {
+  start=$(now_ms)
+  for script in $(pod_scripts); do
+    (cd "$(dirname "$script")" && "$FMAKE" "$@" fmake.props > /dev/null 2>&1) || { echo "fmake failed: $script" >&2; exit 1; }
+  done
+  echo $(( $(now_ms) - start ))
+}
+
+pod_scripts() {
+  i=0
+  while [ $i -lt "$PODS" ]; do
+    echo "$WS/pod$i/fmake.props"
+    i=$(( i + 1 ))
+  done
+  echo "$WS/app/fmake.props"
+}
+
+gen_cmake() {
+  cm="$WS/cmake"
+  mkdir -p "$cm"
+  {
+    echo "cmake_minimum_required(VERSION 3.10)"
+    echo "project(fmake_bench CXX)"
+    i=0
+    while [ $i -lt "$PODS" ]; do
+      j=0
+      while [ $j -lt "$SECTIONS" ]; do
+        name=$(pod_name $i $j)
+        echo "file(GLOB_RECURSE ${name}_SRC $WS/pod$i/src$j/*.cpp)"
+        echo "add_library($name STATIC \${${name}_SRC})"
+        echo "target_include_directories($name PUBLIC $WS/pod$i/inc$j)"
+        if [ $(( i % DEPTH )) -ne 0 ]; then
+          echo "target_link_libraries($name PUBLIC $(pod_name $(( i - 1 )) 0))"
+        fi
+        j=$(( j + 1 ))
+      done
+      i=$(( i + 1 ))
+    done
+    echo "add_executable(app $WS/app/src/main.cpp)"
+    i=0
+    while [ $i -lt "$PODS" ]; do
+      echo "target_link_libraries(app $(pod_name $i 0))"
+      i=$(( i + 1 ))
+    done
+  } > "$cm/CMakeLists.txt"
+}
+
+# Prints elapsed ms of a command
+time_cmd() {
+  start=$(now_ms)
+  "$@" > /dev/null 2>&1 || { echo "failed: $*" >&2; exit 1; }
+  echo $(( $(now_ms) - start ))
+}
+
+echo "Generate workspace $WS"
+gen_workspace
+export FMAKE_REPO="$WS/repo"
+TOUCH_HEADER="$WS/pod0/inc0/$(pod_name 0 0)/h0.h"
+
+echo "Benchmark fmake"
+FM_FULL=$(run_fmake -f) || exit 1
+FM_NOOP=$(run_fmake) || exit 1
+touch "$TOUCH_HEADER"
+FM_TOUCH=$(run_fmake) || exit 1
+FM_GEN=null
+if command -v cmake > /dev/null 2>&1; then
+  FM_GEN=$(run_fmake -G) || exit 1
+fi
+
+CM_GEN=null
+CM_CONF=null
+CM_FULL=null
+CM_NOOP=null
+CM_TOUCH=null
+if command -v cmake > /dev/null 2>&1; then
+  echo "Benchmark cmake"
+  gen_cmake
+  if command -v ninja > /dev/null 2>&1; then
+    CM_GEN="\"Ninja\""
+  else
+    CM_GEN="\"Unix Makefiles\""
+  fi
+  CM_CONF=$(time_cmd cmake -S "$WS/cmake" -B "$WS/cmake/build" -G "$(echo "$CM_GEN" | tr -d '"')" -DCMAKE_BUILD_TYPE=Release) || exit 1
+  CM_FULL=$(time_cmd cmake --build "$WS/cmake/build" -j "$(nproc)") || exit 1
+  CM_NOOP=$(time_cmd cmake --build "$WS/cmake/build" -j "$(nproc)") || exit 1
+  touch "$TOUCH_HEADER"
+  CM_TOUCH=$(time_cmd cmake --build "$WS/cmake/build" -j "$(nproc)") || exit 1
+fi
+
+cat > "$OUT" <<EOF
+{
+  "shape": {"pods": $PODS, "sections": $SECTIONS, "srcs": $SRCS, "fanout": $FANOUT, "depth": $DEPTH, "tree": $TREE},
+  "fmake": {"full_ms": $FM_FULL, "noop_ms": $FM_NOOP, "touch_ms": $FM_TOUCH, "generate_ms": $FM_GEN},
+  "cmake": {"generator": $CM_GEN, "configure_ms": $CM_CONF, "full_ms": $CM_FULL, "noop_ms": $CM_NOOP, "touch_ms": $CM_TOUCH}
+}
+EOF
+cat "$OUT"
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "/tmp/frepo/gcc/release/helloExe/bin/helloExe"
+  "/tmp/frepo/gcc/release/helloExe/bin/helloExe.pdb"
+  "CMakeFiles/helloExe.dir/root/repo/test/cppExe/cpp/fcpp.cpp.o"
+  "CMakeFiles/helloExe.dir/root/repo/test/cppExe/cpp/fcpp.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/helloExe.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
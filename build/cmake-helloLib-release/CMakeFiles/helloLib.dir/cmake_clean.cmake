@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "/tmp/frepo/gcc/release/helloLib/lib/libhelloLib.a"
+  "/tmp/frepo/gcc/release/helloLib/lib/libhelloLib.pdb"
+  "CMakeFiles/helloLib.dir/root/repo/test/cppLib/cpp/hello.cpp.o"
+  "CMakeFiles/helloLib.dir/root/repo/test/cppLib/cpp/hello.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/helloLib.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
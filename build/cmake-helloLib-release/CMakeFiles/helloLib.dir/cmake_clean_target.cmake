@@ -0,0 +1,3 @@
+file(REMOVE_RECURSE
+  "/tmp/frepo/gcc/release/helloLib/lib/libhelloLib.a"
+)
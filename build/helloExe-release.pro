@@ -0,0 +1,21 @@
+#QT -= core gui
+TARGET = helloExe
+TEMPLATE = app
+!isEmpty($$(FMAKE_REPO)) {
+  FMAKE_REPO_LIB = $$(FMAKE_REPO)/gcc/release
+} else {
+  FMAKE_REPO_LIB = "/tmp/frepo/gcc/release"
+}
+QMAKE_CXXFLAGS += -std=c++14
+DEFINES += MY_DEBUG=1
+SOURCES += \
+  ../test/cppExe/cpp/fcpp.cpp \
+
+HEADERS += \
+
+INCLUDEPATH += \
+  ../test/cppLib/cpp \
+
+LIBS += -L$$(FMAKE_REPO_LIB)/helloLib/lib
+LIBS += -lhelloLib
+DESTDIR = $$(FMAKE_REPO_LIB)/helloExe/bin
@@ -0,0 +1,23 @@
+#QT -= core gui
+TARGET = helloLib
+TEMPLATE = lib
+CONFIG   += staticlib
+!isEmpty($$(FMAKE_REPO)) {
+  FMAKE_REPO_LIB = $$(FMAKE_REPO)/gcc/release
+} else {
+  FMAKE_REPO_LIB = "/tmp/frepo/gcc/release"
+}
+SOURCES += \
+  ../test/cppLib/cpp/hello.cpp \
+
+HEADERS += \
+  ../test/cppLib/cpp/hello.h \
+
+INCLUDEPATH += \
+  ../test/cppLib/cpp \
+
+DESTDIR = $$(FMAKE_REPO_LIB)/helloLib/lib
+QMAKE_POST_LINK += $$QMAKE_COPY_DIR ../test/cppLib/res $$(FMAKE_REPO_LIB)/helloLib/res $$escape_expand(\n\t)
+QMAKE_POST_LINK += $$QMAKE_COPY_DIR ../test/cppLib/cpp/*.h $$(FMAKE_REPO_LIB)/helloLib/include $$escape_expand(\n\t)
+QMAKE_POST_LINK += $$QMAKE_COPY_DIR ../test/cppLib/cpp/*.hpp $$(FMAKE_REPO_LIB)/helloLib/include $$escape_expand(\n\t)
+QMAKE_POST_LINK += $$QMAKE_COPY_DIR ../test/cppLib/cpp/*.inl $$(FMAKE_REPO_LIB)/helloLib/include $$escape_expand(\n\t)
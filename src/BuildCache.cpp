@@ -0,0 +1,161 @@
+#include "BuildCache.h"
+#include "Stats.h"
+#include "CacheFile.h"
+#include <set>
+#include <cstdlib>
+
+// Bump when the layout of the snapshot changes
+static const uint32_t cacheVersion = 5;
+
+// Every input of BuildCpp::getFmakeRepoDir besides config.props, which is a parse input
+static std::string repoEnv() {
+    std::string key;
+    bool home = false;
+    for (const char* name : {"FMAKE_REPO", "HOME", "USERPROFILE"}) {
+        const char* env = std::getenv(name);
+        key += std::string(name) + "=" + (env ? env : "") + "\n";
+        home = home || env;
+    }
+    // Without any of them the repo is under the current directory
+    if (!home) {
+        key += fs::current_path().generic_string();
+    }
+    return key;
+}
+
+fs::path BuildCache::cacheFile(const fs::path& scriptFile, const IniSection& section, const BuildCpp& build, bool checkError) {
+    // Sibling script directories share ../build, the directory and stem keep their caches apart
+    std::string name = scriptFile.parent_path().filename().string() + "-" + scriptFile.stem().string();
+    if (!section.name.empty()) {
+        name += "-" + section.name;
+    }
+    std::string compiler = build.compiler.empty() ? "default" : build.compiler;
+    std::string suffix = checkError ? "" : "-nocheck";
+    return scriptFile.parent_path() / ("../build/target-" + name + "-" + compiler + "-" + build.debug + suffix + ".cache");
+}
+
+int64_t BuildCache::fileTime(const fs::path& file) {
+    std::error_code ec;
+    auto time = fs::last_write_time(file, ec);
+    Stats::count(Stats::fileStat);
+    if (ec) {
+        return -1;
+    }
+    return (int64_t)time.time_since_epoch().count();
+}
+
+bool BuildCache::load(const fs::path& file, BuildCpp& build) {
+    Stats::Phase phase("cache");
+    CacheReader r;
+    if (!r.load(file)) {
+        return false;
+    }
+
+    try {
+        if (r.u64() != cacheVersion || r.str() != Utils::exePath()) {
+            return false;
+        }
+        if ((int64_t)r.u64() != fileTime(Utils::exePath()) || r.str() != repoEnv()) {
+            return false;
+        }
+
+        // Check all inputs first, -watch and the Ninja regen edge read them back
+        uint64_t count = r.count();
+        std::vector<fs::path> inputs;
+        for (uint64_t i = 0; i < count; ++i) {
+            fs::path input = r.path();
+            if ((int64_t)r.u64() != fileTime(input)) {
+                return false;
+            }
+            inputs.push_back(input);
+        }
+
+        build.inputs = inputs;
+        build.name = r.str();
+        build.summary = r.str();
+        build.outHome = r.path();
+        build.outBinFile = r.path();
+        uint64_t depCount = r.count();
+        build.depends.clear();
+        for (uint64_t i = 0; i < depCount; ++i) {
+            std::string name = r.str();
+            Depend dep(name);
+            dep.version = r.str();
+            build.depends.push_back(dep);
+        }
+        build.version = r.str();
+        build.outType = (TargetType)r.u64();
+        build.libs = r.strs();
+        build.defines = r.strs();
+        build.incDirs = r.paths();
+        build.libDirs = r.paths();
+        build.sources = r.paths();
+        build.scriptDir = r.path();
+        build.installHeaders = r.paths();
+        build.includeDst = r.str();
+        build.resDirs = r.paths();
+        build.extConfigs = r.map();
+        build.excludeSrc = r.str();
+        build.includeSrc = r.str();
+        build.srcDirs = r.paths();
+        build.installGlobal = r.u64() != 0;
+        build.compiler = r.str();
+        build.pgoTrain = r.str();
+        build.layoutTrain = r.str();
+        build.pgoDrift = std::stod(r.str());
+        build.layoutProfile = r.path();
+        build.configs = r.map();
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+void BuildCache::save(const fs::path& file, const BuildCpp& build) {
+    CacheWriter w;
+    w.u64(cacheVersion);
+    w.str(Utils::exePath());
+    w.u64(fileTime(Utils::exePath()));
+    w.str(repoEnv());
+
+    std::set<fs::path> inputs(build.inputs.begin(), build.inputs.end());
+    w.u64(inputs.size());
+    for (const auto& input : inputs) {
+        w.path(input);
+        w.u64(fileTime(input));
+    }
+
+    w.str(build.name);
+    w.str(build.summary);
+    w.path(build.outHome);
+    w.path(build.outBinFile);
+    w.u64(build.depends.size());
+    for (const auto& dep : build.depends) {
+        w.str(dep.name);
+        w.str(dep.version);
+    }
+    w.str(build.version);
+    w.u64((uint64_t)build.outType);
+    w.strs(build.libs);
+    w.strs(build.defines);
+    w.paths(build.incDirs);
+    w.paths(build.libDirs);
+    w.paths(build.sources);
+    w.path(build.scriptDir);
+    w.paths(build.installHeaders);
+    w.str(build.includeDst);
+    w.paths(build.resDirs);
+    w.map(build.extConfigs);
+    w.str(build.excludeSrc);
+    w.str(build.includeSrc);
+    w.paths(build.srcDirs);
+    w.u64(build.installGlobal ? 1 : 0);
+    w.str(build.compiler);
+    w.str(build.pgoTrain);
+    w.str(build.layoutTrain);
+    w.str(std::to_string(build.pgoDrift));
+    w.path(build.layoutProfile);
+    w.map(build.configs);
+
+    w.save(file);
+}
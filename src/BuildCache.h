@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+#include "BuildCpp.h"
+
+namespace fs = std::filesystem;
+
+// Binary snapshot of a parsed BuildCpp, valid while no input file changed
+class BuildCache {
+public:
+    /**
+     * Cache file of a target
+     */
+    static fs::path cacheFile(const fs::path& scriptFile, const IniSection& section, const BuildCpp& build, bool checkError);
+
+    /**
+     * Load parsed state into build, returns false if missing or outdated
+     */
+    static bool load(const fs::path& file, BuildCpp& build);
+
+    /**
+     * Save parsed state of build
+     */
+    static void save(const fs::path& file, const BuildCpp& build);
+
+private:
+    // Modify time of file, -1 if not exists
+    static int64_t fileTime(const fs::path& file);
+};
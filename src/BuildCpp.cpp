@@ -1,4 +1,6 @@
 #include "BuildCpp.h"
+#include "Stats.h"
+#include "DirCache.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -27,7 +29,8 @@ bool Depend::match(const std::string& realVer) const {
 
 
 // BuildCpp class implementation
-BuildCpp::BuildCpp() : version(std::string("1.0")), debug("release"), installGlobal(false), execute(false) {
+BuildCpp::BuildCpp() : version(std::string("1.0")), debug("release"), installGlobal(false), execute(false),
+    pgo(false), pgoDrift(0.2), layout(false), timeTrace(false), devLink(false) {
 }
 
 void BuildCpp::validate() const {
@@ -36,23 +39,39 @@ void BuildCpp::validate() const {
     }
 }
 
-std::vector<fs::path> BuildCpp::srcList(const std::vector<fs::path>& srcDirs_, const std::regex* excludeSrc_) const {
+// Directory relative to the script directory with trailing '/', without touching the file system
+static std::string relativeDir(const fs::path& dir, const fs::path& base) {
+    std::string rel = dir.lexically_normal().lexically_relative(base.lexically_normal()).generic_string();
+    if (rel.empty() || rel == ".") {
+        return "";
+    }
+    return rel.back() == '/' ? rel : rel + "/";
+}
+
+std::vector<fs::path> BuildCpp::srcList(const std::vector<fs::path>& srcDirs_, PathMatcher& includeSrc_, PathMatcher& excludeSrc_) const {
     std::vector<fs::path> srcs;
+    bool filter = !includeSrc_.empty() || !excludeSrc_.empty();
 
     for (const auto& path : srcDirs_) {
+        Stats::count(Stats::fileStat);
         if (fs::is_directory(path)) {
-            for (const auto& entry : fs::directory_iterator(path)) {
-                if (fs::is_regular_file(entry)) {
-                    std::string ext = entry.path().extension().generic_string();
+            std::string relDir = filter ? relativeDir(path, scriptDir) : std::string();
+            for (const auto& entry : DirCache::list(path)) {
+                if (entry.type == DirCache::file) {
+                    size_t dot = entry.name.rfind('.');
+                    std::string ext = (dot == std::string::npos || dot == 0) ? std::string() : entry.name.substr(dot);
                     if (ext == ".cpp" || ext == ".c" || ext == ".cc" || ext == ".cxx" || ext == ".m" || ext == ".C" || ext == ".c++") {
-                        if (excludeSrc_) {
-                            std::string relPath = fs::relative(entry.path(), scriptDir).generic_string();
-                            if (!std::regex_match(relPath, *excludeSrc_)) {
-                                srcs.push_back(entry.path());
+                        fs::path file = path / entry.name;
+                        if (filter) {
+                            std::string relPath = relDir + entry.name;
+                            if (!includeSrc_.empty() && !includeSrc_.match(relPath)) {
+                                continue;
+                            }
+                            if (!excludeSrc_.empty() && excludeSrc_.match(relPath)) {
+                                continue;
                             }
-                        } else {
-                            srcs.push_back(entry.path());
                         }
+                        srcs.push_back(file);
                     }
                 }
             }
@@ -65,24 +84,20 @@ std::vector<fs::path> BuildCpp::srcList(const std::vector<fs::path>& srcDirs_, c
     return srcs;
 }
 
-std::vector<fs::path> BuildCpp::allDirs(const fs::path& scriptDir, const fs::path& dir) {
-    std::vector<fs::path> subs;
+std::vector<fs::path> BuildCpp::allDirs(const fs::path& scriptDir, const fs::path& dir,
+                                        const std::function<bool(const fs::path&)>& enterDir) {
     fs::path base = scriptDir;
     fs::path fullPath = base / dir;
 
-    if (fs::exists(fullPath) && fs::is_directory(fullPath)) {
-        subs.push_back(fullPath);
-        for (const auto& entry : fs::recursive_directory_iterator(fullPath)) {
-            if (fs::is_directory(entry)) {
-                subs.push_back(entry.path());
-            }
-        }
+    Stats::count(Stats::fileStat);
+    if (fs::is_directory(fullPath)) {
+        return DirCache::walk(fullPath, enterDir);
     }
-
-    return subs;
+    return {};
 }
 
-std::vector<fs::path> BuildCpp::parseDirs(const std::string* str, const std::vector<fs::path>& defV) const {
+std::vector<fs::path> BuildCpp::parseDirs(const std::string* str, const std::vector<fs::path>& defV,
+                                          const std::function<bool(const fs::path&)>& enterDir) {
     if (!str) {
         return defV;
     }
@@ -98,13 +113,16 @@ std::vector<fs::path> BuildCpp::parseDirs(const std::string* str, const std::vec
         if (!token.empty() && token.back() == '*') {
             std::string dirStr = token.substr(0, token.size() - 1);
             fs::path srcUri = scriptDir / dirStr;
-            std::vector<fs::path> dirs = allDirs(scriptDir, srcUri);
+            std::vector<fs::path> dirs = allDirs(scriptDir, srcUri, enterDir);
             srcDirs_.insert(srcDirs_.end(), dirs.begin(), dirs.end());
+            inputs.push_back(srcUri);
+            inputs.insert(inputs.end(), dirs.begin(), dirs.end());
         } else {
             fs::path uri = scriptDir / token;
             if (token == "./") {
                 uri = scriptDir;
             }
+            inputs.push_back(uri);
             if (!fs::exists(uri)) {
                 Utils::throwError("Invalid file: " + uri.generic_string());
             }
@@ -158,9 +176,7 @@ void BuildCpp::osParse(const std::string& os, const std::map<std::string, std::s
     // Get srcDirs
     it = props.find(os + "srcDirs");
     if (it != props.end()) {
-        std::string srcDirsStr = it->second;
-        std::vector<fs::path> parsedSrcDirs = parseDirs(&srcDirsStr, {});
-        srcDirs.insert(srcDirs.end(), parsedSrcDirs.begin(), parsedSrcDirs.end());
+        srcDirsProps.push_back(it->second);
     }
     
     // Get excludeSrc
@@ -169,10 +185,17 @@ void BuildCpp::osParse(const std::string& os, const std::map<std::string, std::s
         excludeSrc = it->second;
     }
 
+    // Get includeSrc
+    it = props.find(os + "includeSrc");
+    if (it != props.end()) {
+        includeSrc = it->second;
+    }
+
     // Get includeDir
     it = props.find(os + "incDir");
     if (it != props.end()) {
         fs::path incDir = scriptDir / it->second;
+        inputs.push_back(incDir);
         installHeaders.push_back(incDir);
         if (fs::is_directory(incDir)) {
             incDirs.push_back(incDir);
@@ -306,6 +329,24 @@ void BuildCpp::osParse(const std::string& os, const std::map<std::string, std::s
         extConfigs["linkflags"] = (it->second);
     }
 
+    // Get PGO options
+    it = props.find(os + "pgoTrain");
+    if (it != props.end()) {
+        pgoTrain = it->second;
+    }
+    it = props.find(os + "layoutTrain");
+    if (it != props.end()) {
+        layoutTrain = it->second;
+    }
+    it = props.find(os + "pgoDrift");
+    if (it != props.end()) {
+        pgoDrift = std::stod(it->second);
+    }
+    it = props.find(os + "layoutProfile");
+    if (it != props.end()) {
+        layoutProfile = fs::absolute(scriptDir / it->second);
+    }
+
     // Get extConfigs
     getStartsWith(os + "extConfigs.", props, extConfigs);
 }
@@ -363,22 +404,24 @@ void BuildCpp::walkDepends(const Depend& dep, std::map<std::string, int>& depend
     fs::path metaPath = outHome / dep.name / "meta.props";
 
     std::vector<std::string> ndeps;
-    if (fs::exists(metaPath)) {
-        auto meta = Utils::readProps(metaPath);
-        std::string depends;
-        for (const auto& [k, v] : meta) {
-            if (k == "pod.depends") {
-                depends = v;
-                break;
-            }
+    std::string depends;
+    const RepoEntry* entry = repoIndex.find(dep.name);
+    if (entry) {
+        depends = entry->depends;
+    } else {
+        inputs.push_back(metaPath);
+        Stats::count(Stats::fileStat);
+        if (fs::exists(metaPath)) {
+            auto meta = Utils::readProps(metaPath);
+            depends = meta["pod.depends"];
         }
-        if (depends.size() > 0) {
-            depends = Utils::replaceAll(depends, ";", ",");
-            std::vector<std::string> tokens = Utils::split(depends, ',');
-            for (const auto& token : tokens) {
-                if (!token.empty()) {
-                    ndeps.push_back(token);
-                }
+    }
+    if (depends.size() > 0) {
+        depends = Utils::replaceAll(depends, ";", ",");
+        std::vector<std::string> tokens = Utils::split(depends, ',');
+        for (const auto& token : tokens) {
+            if (!token.empty()) {
+                ndeps.push_back(token);
             }
         }
     }
@@ -403,6 +446,39 @@ void BuildCpp::recursiveDepends() {
 
 void BuildCpp::applayModule(bool checkError, const Depend& dep) {
     //fs::path outHome = outDir;
+    const RepoEntry* entry = repoIndex.find(dep.name);
+    if (entry) {
+        if (!dep.match(entry->version)) {
+            Utils::throwError("Cannot resolve depend: '" + dep.name + " " + entry->version + "' != '" + dep.toStr() + "'");
+        }
+        for (const auto& token : entry->includes) {
+            //windows: /C:/x
+            if (token.size() > 3 && token[0] == '/' && token[2] == ':') {
+                incDirs.push_back(token.substr(1, token.size() - 1));
+            } else {
+                incDirs.push_back(token);
+            }
+            inputs.push_back(incDirs.back());
+        }
+        if (!entry->includesRewrite) {
+            fs::path depIncPath = outHome / dep.name / "include/";
+            inputs.push_back(depIncPath);
+            incDirs.push_back(depIncPath);
+        }
+        fs::path depLibPath = outHome / dep.name / "lib/";
+        inputs.push_back(depLibPath);
+        libDirs.push_back(depLibPath);
+        libs.insert(libs.end(), entry->libs.begin(), entry->libs.end());
+        if (entry->libs.empty()) {
+            if (checkError) {
+                Utils::throwError("Don't find any lib in " + depLibPath.generic_string());
+            } else {
+                std::cerr << "Don't find any lib in " + depLibPath.generic_string() << std::endl;
+            }
+        }
+        return;
+    }
+
     bool includesRewrite = false;
     fs::path metaPath = outHome / dep.name / "meta.props";
 
@@ -432,6 +508,7 @@ void BuildCpp::applayModule(bool checkError, const Depend& dep) {
                     else {
                         includePath = token;
                     }
+                    inputs.push_back(includePath);
                     if (fs::exists(includePath)) {
                         incDirs.push_back(includePath);
                     } else {
@@ -445,6 +522,7 @@ void BuildCpp::applayModule(bool checkError, const Depend& dep) {
 
     if (!includesRewrite) {
         fs::path depIncPath = outHome / dep.name / "include/";
+        inputs.push_back(depIncPath);
         if (!fs::exists(depIncPath)) {
             if (checkError) {
                 Utils::throwError("Don't find the depend " + dep.toStr());
@@ -457,6 +535,7 @@ void BuildCpp::applayModule(bool checkError, const Depend& dep) {
 
 
     fs::path depLibPath = outHome / dep.name / "lib/";
+    inputs.push_back(depLibPath);
     if (!fs::exists(depLibPath)) {
         if (checkError) {
             Utils::throwError("Don't find the depend " + dep.toStr());
@@ -469,38 +548,9 @@ void BuildCpp::applayModule(bool checkError, const Depend& dep) {
 
 
     //find .lib file
-    int count = 0;
-    for (const auto& entry : fs::directory_iterator(depLibPath)) {
-        if (fs::is_regular_file(entry)) {
-            std::string ext = entry.path().extension().generic_string();
-            if (ext == ".a" || ext == ".so") {
-                std::string libName = entry.path().filename().generic_string();
-                if (libName.substr(0, 3) == "lib" && libName.substr(libName.size() - 2) == ".a") {
-                    libs.push_back(libName.substr(3, libName.size() - 5));
-                } else if (libName.substr(0, 3) == "lib" && libName.substr(libName.size() - 3) == ".so") {
-                    libs.push_back(libName.substr(3, libName.size() - 6));
-                } else {
-                    libs.push_back(libName);
-                }
-                count++;
-            }
-        }
-    }
-
-
-    if (count == 0) {
-        if (fs::exists(depLibPath)) {
-            for (const auto& entry : fs::directory_iterator(depLibPath)) {
-                if (fs::is_regular_file(entry)) {
-                    std::string ext = entry.path().extension().generic_string();
-                    if (ext == ".lib") {
-                        libs.push_back(entry.path().filename().generic_string());
-                        count++;
-                    }
-                }
-            }
-        }
-    }
+    std::vector<std::string> names = RepoIndex::libNames(depLibPath);
+    libs.insert(libs.end(), names.begin(), names.end());
+    size_t count = names.size();
 
     if (count == 0) {
         if (checkError) {
@@ -541,19 +591,34 @@ std::string BuildCpp::getVirtualModuleItem(std::map<std::string, std::string>& c
 void BuildCpp::applayDepends(bool checkError) {
     //fs::path outHome = outDir;
 
+    // Read on first use
+    std::vector<IniSection> virtualModules;
+    bool virtualLoaded = false;
+
     for (const auto& dep : depends) {
+        if (repoIndex.find(dep.name)) {
+            applayModule(checkError, dep);
+            continue;
+        }
+
         fs::path metaPath = outHome / dep.name / "meta.props";
+        inputs.push_back(metaPath);
 
+        Stats::count(Stats::fileStat);
         if (fs::exists(metaPath)) {
             applayModule(checkError, dep);
         }
         else {
-            fs::path exePath = Utils::exePath();
-            fs::path configFile = exePath.parent_path() / "virtual_modules.ini";
+            if (!virtualLoaded) {
+                fs::path exePath = Utils::exePath();
+                fs::path configFile = exePath.parent_path() / "virtual_modules.ini";
+                inputs.push_back(configFile);
+                virtualModules = Utils::readIni(configFile.string());
+                virtualLoaded = true;
+            }
 
-            std::vector<IniSection> sections = Utils::readIni(configFile.string());
             std::map<std::string, std::string> configs;
-            for (const auto& section : sections) {
+            for (const auto& section : virtualModules) {
                 if (section.name == dep.name) {
                     configs = section.props;
                 }
@@ -602,8 +667,13 @@ void BuildCpp::applayDepends(bool checkError) {
 
 
 void BuildCpp::parse(const fs::path& scriptFile, bool checkError, IniSection& section) {
+    Stats::Phase phase("parse");
     scriptDir = scriptFile.parent_path();
+    DirCache::load(scriptDir / "../build/dirs.cache");
 
+    inputs.push_back(scriptFile);
+    inputs.push_back(fs::path(Utils::exePath()).parent_path() / "config.props");
+    inputs.push_back(scriptDir / "config.props");
     Utils::loadConfigs(scriptDir, configs, "config.props");
 
     std::map<std::string, std::string> propsMap = section.props;
@@ -655,14 +725,33 @@ void BuildCpp::parse(const fs::path& scriptFile, bool checkError, IniSection& se
     }
 
     // Parse sources
-    std::regex* excludeRegex = nullptr;
-    std::regex excludeRegexObj;
-    if (!excludeSrc.empty()) {
-        excludeRegexObj = std::regex(excludeSrc);
-        excludeRegex = &excludeRegexObj;
+    {
+        Stats::Phase srcPhase("sources");
+        PathMatcher includeMatcher;
+        PathMatcher excludeMatcher;
+        includeMatcher.add(includeSrc);
+        excludeMatcher.add(excludeSrc);
+
+        // Skip directories no source can be taken from
+        auto enterDir = [&](const fs::path& dir) {
+            std::string relDir = relativeDir(dir, scriptDir);
+            if (!includeMatcher.empty() && includeMatcher.noneBelow(relDir)) {
+                return false;
+            }
+            if (!excludeMatcher.empty() && excludeMatcher.allBelow(relDir)) {
+                return false;
+            }
+            return true;
+        };
+        for (const std::string& srcDirsStr : srcDirsProps) {
+            std::vector<fs::path> parsedSrcDirs = parseDirs(&srcDirsStr, {}, enterDir);
+            srcDirs.insert(srcDirs.end(), parsedSrcDirs.begin(), parsedSrcDirs.end());
+        }
+
+        auto parsedSources = srcList(srcDirs, includeMatcher, excludeMatcher);
+        sources.insert(sources.end(), parsedSources.begin(), parsedSources.end());
+        DirCache::save();
     }
-    auto parsedSources = srcList(srcDirs, excludeRegex);
-    sources.insert(sources.end(), parsedSources.begin(), parsedSources.end());
 
     // Set default outDir
     if (outHome.empty()) {
@@ -671,10 +760,15 @@ void BuildCpp::parse(const fs::path& scriptFile, bool checkError, IniSection& se
         outHome = outDirFile;
     }
 
-    recursiveDepends();
+    {
+        Stats::Phase depPhase("depends");
+        repoIndex.load(outHome);
+        inputs.push_back(repoIndex.file);
+        recursiveDepends();
 
-    // Apply dependencies
-    applayDepends(checkError);
+        // Apply dependencies
+        applayDepends(checkError);
+    }
 
     // Reverse libs
     std::reverse(libs.begin(), libs.end());
@@ -694,6 +788,8 @@ void BuildCpp::dump() const {
     std::cout << "compiler: " << compiler << std::endl;
     std::cout << "installGlobal: " << (installGlobal ? "true" : "false") << std::endl;
     std::cout << "execute: " << (execute ? "true" : "false") << std::endl;
+    std::cout << "pgo: " << (pgo ? "true" : "false") << std::endl;
+    std::cout << "layout: " << (layout ? "true" : "false") << std::endl;
 
     std::cout << "depends: " << std::endl;
     for (const auto& dep : depends) {
@@ -5,7 +5,10 @@
 #include <filesystem>
 #include <regex>
 #include <map>
+#include <functional>
 #include "Utils.h"
+#include "PathMatcher.h"
+#include "RepoIndex.h"
 
 namespace fs = std::filesystem;
 
@@ -83,9 +86,12 @@ public:
     // Ext compiler options
     std::map<std::string, std::string> extConfigs;
 
-    // Exclude src file by regex
+    // Exclude src files matching these patterns
     std::string excludeSrc;
 
+    // Only take src files matching these patterns
+    std::string includeSrc;
+
     // Src directories
     std::vector<fs::path> srcDirs;
 
@@ -98,8 +104,35 @@ public:
     // Execute build result
     bool execute;
 
+    // Profile-guided optimization build
+    bool pgo;
+
+    // Arguments passed to the binary for the PGO training run
+    std::string pgoTrain;
+
+    // Arguments of the -layout training run, pgoTrain if empty
+    std::string layoutTrain;
+
+    // Ratio of changed sources that invalidates the stored profile
+    double pgoDrift;
+
+    // Post-link function layout optimization
+    bool layout;
+
+    // Recorded perf data for llvm-bolt
+    fs::path layoutProfile;
+
+    // Compile with -ftime-trace and report
+    bool timeTrace;
+
+    // Link library pods as shared objects in debug builds
+    bool devLink;
+
     std::map<std::string, std::string> configs;
 
+    // Files and directories read by parse, a change invalidates the parse cache
+    std::vector<fs::path> inputs;
+
     // Constructor
     BuildCpp();
 
@@ -110,6 +143,11 @@ public:
     void dump() const;
 
 private:
+    // srcDirs of all matched sections, resolved once the src patterns are known
+    std::vector<std::string> srcDirsProps;
+
+    // Installed pods of outHome
+    RepoIndex repoIndex;
 
     void applayModule(bool checkError, const Depend& dep);
     // Apply dependencies
@@ -124,13 +162,15 @@ private:
     void validate() const;
 
     // Get source files list
-    std::vector<fs::path> srcList(const std::vector<fs::path>& srcDirs, const std::regex* excludeSrc) const;
+    std::vector<fs::path> srcList(const std::vector<fs::path>& srcDirs, PathMatcher& includeSrc, PathMatcher& excludeSrc) const;
 
     // Get all subdirectories
-    static std::vector<fs::path> allDirs(const fs::path& scriptDir, const fs::path& dir);
+    static std::vector<fs::path> allDirs(const fs::path& scriptDir, const fs::path& dir,
+                                         const std::function<bool(const fs::path&)>& enterDir = nullptr);
 
     // Parse directories from string
-    std::vector<fs::path> parseDirs(const std::string* str, const std::vector<fs::path>& defV) const;
+    std::vector<fs::path> parseDirs(const std::string* str, const std::vector<fs::path>& defV,
+                                    const std::function<bool(const fs::path&)>& enterDir = nullptr);
 
     // OS specific parse
     void osParse(const std::string& os, const std::map<std::string, std::string>& props);
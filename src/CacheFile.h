@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+
+#include "Stats.h"
+
+namespace fs = std::filesystem;
+
+// Binary writer of fmake's cache files
+class CacheWriter {
+public:
+    std::string data;
+
+    void u64(uint64_t v) {
+        data.append((const char*)&v, sizeof(v));
+    }
+    void str(const std::string& s) {
+        u64(s.size());
+        data.append(s);
+    }
+    void path(const fs::path& p) {
+        str(p.generic_string());
+    }
+    void strs(const std::vector<std::string>& list) {
+        u64(list.size());
+        for (const auto& s : list) {
+            str(s);
+        }
+    }
+    void paths(const std::vector<fs::path>& list) {
+        u64(list.size());
+        for (const auto& p : list) {
+            path(p);
+        }
+    }
+    void map(const std::map<std::string, std::string>& m) {
+        u64(m.size());
+        for (const auto& [k, v] : m) {
+            str(k);
+            str(v);
+        }
+    }
+
+    // Write to a temp file and rename, readers never see a partial file
+    void save(const fs::path& file) const {
+        fs::create_directories(file.parent_path());
+        fs::path tmpFile = file.generic_string() + ".tmp";
+        std::ofstream ofs(tmpFile, std::ios::binary);
+        ofs.write(data.data(), data.size());
+        ofs.close();
+        fs::rename(tmpFile, file);
+    }
+};
+
+// Binary reader of fmake's cache files, throws on truncated data
+class CacheReader {
+public:
+    std::string data;
+    size_t pos = 0;
+
+    // Read whole file, false if missing
+    bool load(const fs::path& file) {
+        std::ifstream ifs(file, std::ios::binary);
+        if (!ifs.is_open()) {
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << ifs.rdbuf();
+        data = buffer.str();
+        pos = 0;
+        Stats::count(Stats::fileRead);
+        Stats::count(Stats::bytesRead, data.size());
+        return true;
+    }
+
+    uint64_t u64() {
+        if (pos + sizeof(uint64_t) > data.size()) {
+            throw std::runtime_error("Bad cache file");
+        }
+        uint64_t v;
+        data.copy((char*)&v, sizeof(v), pos);
+        pos += sizeof(v);
+        return v;
+    }
+    // Element count, each element takes at least 8 bytes
+    uint64_t count() {
+        uint64_t n = u64();
+        if (n > (data.size() - pos) / sizeof(uint64_t)) {
+            throw std::runtime_error("Bad cache file");
+        }
+        return n;
+    }
+    std::string str() {
+        uint64_t size = u64();
+        if (size > data.size() - pos) {
+            throw std::runtime_error("Bad cache file");
+        }
+        std::string s = data.substr(pos, size);
+        pos += size;
+        return s;
+    }
+    fs::path path() {
+        return fs::path(str());
+    }
+    std::vector<std::string> strs() {
+        std::vector<std::string> list(count());
+        for (auto& s : list) {
+            s = str();
+        }
+        return list;
+    }
+    std::vector<fs::path> paths() {
+        std::vector<fs::path> list(count());
+        for (auto& p : list) {
+            p = path();
+        }
+        return list;
+    }
+    std::map<std::string, std::string> map() {
+        std::map<std::string, std::string> m;
+        uint64_t size = count();
+        for (uint64_t i = 0; i < size; ++i) {
+            std::string k = str();
+            m[k] = str();
+        }
+        return m;
+    }
+};
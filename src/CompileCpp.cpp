@@ -1,15 +1,41 @@
 #include "CompileCpp.h"
 #include "Utils.h"
+#include "TimeTrace.h"
+#include "Stats.h"
+#include "RepoIndex.h"
+#include "StatCache.h"
 #include <fstream>
+#include <cstdint>
 #include <sstream>
 #include <iostream>
 #include <cstdlib>
 #include <chrono>
 #include <algorithm>
 #include <string.h>
+#include <set>
+#include <unordered_map>
+#include <iomanip>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 
-CompileCpp::CompileCpp(const BuildCpp& buildInfo) : buildInfo(buildInfo), version(buildInfo.version) {
+// Include graphs by include path
+static std::map<std::string, std::map<std::string, std::vector<std::string>>> includeGraphs;
+
+// Quoted include names of each file read, shared by all graphs
+static std::unordered_map<std::string, std::vector<std::string>> includeNames;
+
+static std::map<std::string, std::vector<std::string>>& includeGraph(const BuildCpp& buildInfo) {
+    std::string key;
+    for (const auto& dir : buildInfo.incDirs) {
+        key += StatCache::key(dir) + "\n";
+    }
+    return includeGraphs[key];
+}
+
+CompileCpp::CompileCpp(const BuildCpp& buildInfo) : buildInfo(buildInfo), includeMap(includeGraph(buildInfo)), version(buildInfo.version), bolt(false), devLink(false), linked(false) {
+    Stats::Phase phase("toolchain");
     compiler = buildInfo.compiler;
     Utils::loadConfigs(buildInfo.scriptDir, configs, "tool_chain.props");
     for (auto it = buildInfo.configs.begin(); it != buildInfo.configs.end(); ++it) {
@@ -22,18 +48,31 @@ CompileCpp::CompileCpp(const BuildCpp& buildInfo) : buildInfo(buildInfo), versio
     outPodDir = buildInfo.outHome / buildInfo.name;
     objDir = buildInfo.scriptDir / ("../build/obj-" + buildInfo.name + "-" + compiler + "-" + buildInfo.debug);
     fs::create_directories(objDir);
+    baseConfigs = configs;
+
+    // BOLT rewrites the linked binary with a recorded perf profile
+    bolt = buildInfo.layout && buildInfo.outType != TargetType::lib && !buildInfo.layoutProfile.empty()
+        && !config(compiler + ".bolt", "").empty() && !Utils::findExe("llvm-bolt").empty();
+
+    // Release builds always link statically
+    if (buildInfo.devLink && buildInfo.debug == "debug") {
+        if (config(compiler + ".rpath", "").empty()) {
+            Utils::throwError("Option -devlink not supported by compiler: " + compiler);
+        }
+        devLink = true;
+    }
 }
 
 void CompileCpp::init() {
+    Stats::Phase phase("init");
     // Create directories
     fs::create_directories(outPodDir);
 
-    fs::path dir = (buildInfo.outType == TargetType::exe) ? "bin/" : "lib/";
-    fs::path outBinDir = outPodDir / dir;
+    fs::path outBinDir = binDir();
     fs::create_directories(outBinDir);
 
     outFile = outBinDir / buildInfo.name;
-    if (buildInfo.outType == TargetType::exe && !buildInfo.outBinFile.empty()) {
+    if (buildInfo.outType == TargetType::exe && !buildInfo.outBinFile.empty() && trainDir.empty()) {
         outFile = buildInfo.outBinFile;
         if (!fs::exists(outFile.parent_path())) {
             fs::create_directories(outFile.parent_path());
@@ -56,13 +95,19 @@ void CompileCpp::init() {
     meta["pod.depends"] = dependsStr;
     meta["pod.summary"] = buildInfo.summary;
     
-    // Get current time
-    std::time_t t = std::time(nullptr);
-    meta["pod.buildTime"] = std::to_string(t);
+    // SOURCE_DATE_EPOCH asks for reproducible output, it replaces the current time
+    const char* epoch = std::getenv("SOURCE_DATE_EPOCH");
+    bool reproducible = epoch && *epoch;
+    if (reproducible) {
+        meta["pod.buildTime"] = epoch;
+    } else {
+        std::time_t t = std::time(nullptr);
+        meta["pod.buildTime"] = std::to_string(t);
+    }
     meta["pod.compiler"] = compiler;
 
-    // Initialize includes
-    if (buildInfo.includeDst.empty()) {
+    // Initialize includes, a reproducible pod has no paths into the checkout
+    if (buildInfo.includeDst.empty() && !reproducible) {
         std::vector<std::string> includes;
         for (const auto& includeDir : buildInfo.installHeaders) {
             if (fs::is_directory(includeDir)) {
@@ -103,6 +148,45 @@ void CompileCpp::init() {
         configs[k] = v;
     }
 
+    // Add extra flags
+    if (!extFlags.empty()) {
+        configs["cflags"] += " " + extFlags;
+        configs["cppflags"] += " " + extFlags;
+        configs["linkflags"] += " " + extFlags;
+    }
+    if (bolt) {
+        configs["linkflags"] += " " + config(compiler + ".boltLink", "");
+    }
+    if (reproducible) {
+        // Strip the checkout and repo locations from debug info, __FILE__ and LTO objects
+        std::string workDir = (buildInfo.scriptDir / "..").lexically_normal().generic_string();
+        std::string repoDir = buildInfo.outHome.lexically_normal().generic_string();
+        configs["workDir"] = fileToStr(workDir.substr(0, workDir.find_last_not_of('/') + 1));
+        configs["repoDir"] = fileToStr(repoDir.substr(0, repoDir.find_last_not_of('/') + 1));
+        std::string flags = config(compiler + ".reproducible", "");
+        configs["cflags"] += " " + flags;
+        configs["cppflags"] += " " + flags;
+        configs["linkflags"] += " " + flags;
+    }
+    // Shared depends are found at run time in the repo, also those a -devlink build left for a plain one
+    bool sharedDepends = devLink;
+    if (!config(compiler + ".rpath", "").empty()) {
+        for (const auto& libFile : linkedLibs()) {
+            sharedDepends = sharedDepends || libFile.extension() == ".so";
+        }
+    }
+    if (sharedDepends) {
+        configs["linkflags"] += " @{" + compiler + ".rpath}";
+    }
+    if (buildInfo.timeTrace) {
+        std::string traceFlags = config(compiler + ".timeTrace", "");
+        if (traceFlags.empty()) {
+            Utils::throwError("Option -time-trace not supported by compiler: " + compiler);
+        }
+        configs["cflags"] += " " + traceFlags;
+        configs["cppflags"] += " " + traceFlags;
+    }
+
     // Apply macros for list
     std::map<std::string, std::vector<std::string>> params;
     params["libNames"] = buildInfo.libs;
@@ -119,25 +203,23 @@ void CompileCpp::init() {
         libDirsStr.push_back(fileToStr(adir));
     }
     params["libDirs"] = libDirsStr;
+    params["rpathDirs"] = libDirsStr;
 
+    std::vector<fs::path> sources = buildInfo.sources;
+    sources.insert(sources.end(), extSources.begin(), extSources.end());
     std::vector<std::string> objList;
-    for (const auto& f : buildInfo.sources) {
+    for (const auto& f : sources) {
         fs::path objFile = getObjFile(f);
-        fs::path curDir = fs::current_path();
+        fs::path curDir = linkDir.empty() ? fs::current_path() : linkDir;
         fs::path relObjFile = fs::relative(objFile, curDir);
         objList.push_back(fileToStr(relObjFile));
     }
+    // Link and archive order must not depend on how the sources were found
+    std::sort(objList.begin(), objList.end());
     params["objList"] = objList;
 
-    applayMacrosForList(params);
-    selectMacros(buildInfo.debug);
-    fileDirtyMap.clear();
-
-    // Delete old lib file
-    fs::path oldFile = outBinDir / ("lib" + buildInfo.name + ".a");
-    if (fs::exists(oldFile)) {
-        fs::remove(oldFile);
-    }
+    applayMacrosForList(configs, params);
+    selectMacros(configs, buildInfo.debug);
 
     // Set environment variables
     std::string inc = config(compiler + ".env.incDirs", "");
@@ -183,57 +265,1005 @@ fs::path CompileCpp::getObjFile(const fs::path& srcFile) const {
 }
 
 void CompileCpp::run() {
-    std::cout << "Compile module: " << buildInfo.name << " compiler: " << compiler << std::endl;
+    std::vector<CompileCpp*> targets = {this};
+    runAll(targets);
+}
+
+void CompileCpp::runAll(const std::vector<CompileCpp*>& targets) {
+    // Plain builds share one compile scheduler, profiled builds train in between and run alone
+    std::vector<CompileJob> jobs;
+    for (CompileCpp* cc : targets) {
+        std::cout << "Compile module: " << cc->buildInfo.name << " compiler: " << cc->compiler << " mode: " << cc->buildInfo.debug << std::endl;
+        if (cc->profiled().empty()) {
+            if (cc->buildInfo.pgo || (cc->buildInfo.layout && !cc->bolt)) {
+                std::cerr << "Profile build only supports exe target, ignored" << std::endl;
+            }
+            std::vector<CompileJob> more = cc->prepare();
+            jobs.insert(jobs.end(), more.begin(), more.end());
+        } else if (cc->buildInfo.pgo && cc->buildInfo.layout && !cc->bolt) {
+            // One instrumented training run per build, the PGO one wins
+            std::cerr << "Layout build can't be combined with -pgo, -layout ignored" << std::endl;
+        }
+    }
+    // Sections sharing a source directory with the same flags compile each TU once,
+    // the other targets get a hard link of the object
+    std::vector<CompileJob> unique;
+    std::vector<std::pair<size_t, fs::path>> shared;
+    std::unordered_map<std::string, size_t> first;
+    for (auto& job : jobs) {
+        auto it = job.key.empty() ? first.end() : first.find(job.key);
+        if (it != first.end()) {
+            shared.emplace_back(it->second, job.objFile);
+            continue;
+        }
+        if (!job.key.empty()) {
+            first[job.key] = unique.size();
+        }
+        unique.push_back(std::move(job));
+    }
+    compileAll(unique);
+    for (const auto& [index, objFile] : shared) {
+        std::cout << "Share " << unique[index].objFile.generic_string() << " as " << objFile.generic_string() << std::endl;
+        fs::create_directories(objFile.parent_path());
+        Utils::installFile(unique[index].objFile, objFile, true);
+    }
+
+    for (CompileCpp* cc : targets) {
+        std::string kind = cc->profiled();
+        if (kind.empty()) {
+            cc->link();
+        } else {
+            cc->runProfiled(kind);
+        }
+        cc->finish();
+    }
+}
+
+std::string CompileCpp::profiled() const {
+    if (buildInfo.outType != TargetType::exe) {
+        return "";
+    }
+    if (buildInfo.pgo) {
+        return "pgo";
+    }
+    return (buildInfo.layout && !bolt) ? "layout" : "";
+}
+
+void CompileCpp::finish() {
+    if (bolt) {
+        runBolt();
+    }
+
+    if (buildInfo.timeTrace) {
+        reportTimeTrace();
+    }
+
+    // Install
+    install();
+
+    std::cout << "BUILD SUCCESS" << std::endl;
+
+    // Execute if needed
+    if (buildInfo.execute && buildInfo.outType == TargetType::exe) {
+        exeBin();
+    }
+}
+
+void CompileCpp::rerun(const std::vector<fs::path>& changed) {
+    std::vector<std::string> keys;
+    for (const auto& file : changed) {
+        keys.push_back(StatCache::key(file));
+    }
+    if (!keys.empty()) {
+        forgetIncludes(keys);
+        StatCache::forget(keys);
+    }
+    configs = baseConfigs;
+    objDir = buildInfo.scriptDir / ("../build/obj-" + buildInfo.name + "-" + compiler + "-" + buildInfo.debug);
+    run();
+}
+
+std::vector<fs::path> CompileCpp::inputFiles() const {
+    std::vector<fs::path> files = buildInfo.sources;
+    for (const auto& [file, includes] : includeMap) {
+        files.push_back(file);
+    }
+    return files;
+}
+
+void CompileCpp::build() {
+    std::vector<CompileJob> jobs = prepare();
+    compileAll(jobs);
+    link();
+}
 
+std::vector<CompileJob> CompileCpp::prepare() {
     init();
 
-    for (const auto& srcFile : buildInfo.sources) {
-        // Set srcFile in configs
-        configs["srcFile"] = fileToStr(srcFile);
+    std::vector<fs::path> sources = buildInfo.sources;
+    sources.insert(sources.end(), extSources.begin(), extSources.end());
+
+    CmdTemplate compC = compileCmd("comp", "c");
+    CmdTemplate compCpp = compileCmd("comp", "cpp");
+    writeCompileDb(sources, compC, compCpp);
+
+    std::vector<fs::path> dirty;
+    {
+        Stats::Phase dirtyPhase("dirty");
+        dirty = dirtySources(sources);
+    }
 
+    std::vector<CompileJob> jobs;
+    for (const auto& srcFile : dirty) {
         fs::path objFile = getObjFile(srcFile);
-        if (fs::exists(objFile) && fs::is_regular_file(objFile)) {
-            auto objTime = fs::last_write_time(objFile);
-            // Subtract 1 second
-            auto srcTime = fs::last_write_time(srcFile);
-            if (!isDirty(srcFile, objTime)) {
-                continue;
+        // Select command based on file type
+        const CmdTemplate& comp = (srcFile.extension() == ".c") ? compC : compCpp;
+        CompileJob job;
+        job.args = comp.fill(srcFile, objFile);
+        job.objFile = objFile;
+        // -ftime-trace writes a file beside the object
+        if (!buildInfo.timeTrace) {
+            job.key = joinArgs(comp.fill(srcFile, ""));
+        }
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+void CompileCpp::compileAll(std::vector<CompileJob>& jobs, bool keepGoing) {
+    if (jobs.empty()) {
+        return;
+    }
+    Stats::Phase phase("compile");
+    Stats::count(Stats::process, jobs.size());
+    for (const auto& job : jobs) {
+        fs::create_directories(job.objFile.parent_path());
+        // A shared object is a hard link, the compiler would write through it into the other target
+        std::error_code ec;
+        if (fs::hard_link_count(job.objFile, ec) > 1) {
+            fs::remove(job.objFile, ec);
+        }
+    }
+
+    // Workers take the next job until all are done or one failed
+    std::atomic<size_t> next(0);
+    std::mutex mutex;
+    std::string error;
+    auto work = [&]() {
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            std::string cmd = joinArgs(jobs[i].args);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error.empty() && !keepGoing) {
+                    return;
+                }
+                std::cout << "Exec " << cmd << std::endl;
+            }
+            if (std::system(cmd.c_str()) != 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs[i].failed = true;
+                if (error.empty()) {
+                    error = "Exec failed [" + cmd + "]";
+                }
+            }
+        }
+    };
+    size_t count = std::min<size_t>(jobs.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::vector<std::string> keys;
+    for (const auto& job : jobs) {
+        keys.push_back(StatCache::key(job.objFile));
+    }
+    StatCache::forget(keys);
+    if (!error.empty()) {
+        Utils::throwError(error);
+    }
+}
+
+void CompileCpp::link() {
+    std::vector<fs::path> sources = buildInfo.sources;
+    sources.insert(sources.end(), extSources.begin(), extSources.end());
+
+    // Link, skipped while the command, objects and libraries are the same as at the last link
+    Stats::Phase linkPhase("link");
+    std::string cmd = expandCmd(linkCmdName());
+    digests.load(objDir / "digests.cache");
+    uint64_t inputs = DigestCache::hash(cmd.data(), cmd.size());
+    std::vector<fs::path> objFiles;
+    for (const auto& srcFile : sources) {
+        objFiles.push_back(getObjFile(srcFile));
+    }
+    std::sort(objFiles.begin(), objFiles.end());
+    for (const auto& file : objFiles) {
+        uint64_t digest = digests.digest(file);
+        inputs = DigestCache::hash(&digest, sizeof(digest), inputs);
+    }
+    for (const auto& file : linkedLibs()) {
+        // A shared depend of -devlink is loaded at run time, rebuilding it needs no relink
+        if (devLink && file.extension() == ".so") {
+            std::string name = file.generic_string();
+            inputs = DigestCache::hash(name.data(), name.size(), inputs);
+            continue;
+        }
+        uint64_t digest = digests.digest(file);
+        inputs = DigestCache::hash(&digest, sizeof(digest), inputs);
+    }
+    // llvm-bolt rewrites the output after link
+    linked = false;
+    if (!bolt && digests.linkUpToDate(inputs, outputsDigest())) {
+        std::cout << "Link up to date: " << outFile.generic_string() << std::endl;
+        digests.save();
+        return;
+    }
+
+    // ar appends, start from an empty archive
+    fs::path oldFile = binDir() / ("lib" + buildInfo.name + ".a");
+    if (fs::exists(oldFile)) {
+        fs::remove(oldFile);
+    }
+    // A library pod switching to or from -devlink must not leave the other flavor for consumers
+    if (buildInfo.outType == TargetType::lib) {
+        fs::path sharedFile = oldFile.parent_path() / ("lib" + buildInfo.name + ".so");
+        if (fs::exists(sharedFile)) {
+            fs::remove(sharedFile);
+        }
+    }
+    runArgs(splitCmd(cmd));
+    linked = true;
+    StatCache::forgetUnder({StatCache::key(oldFile.parent_path()), StatCache::key(outFile)});
+    digests.recordLink(inputs, outputsDigest());
+    digests.save();
+}
+
+void CompileCpp::analyzeAll(const std::vector<CompileCpp*>& targets) {
+    std::vector<CompileJob> jobs;
+    for (CompileCpp* cc : targets) {
+        std::cout << "Analyze module: " << cc->buildInfo.name << " compiler: " << cc->compiler << " mode: " << cc->buildInfo.debug << std::endl;
+        std::vector<CompileJob> more = cc->prepareAnalysis();
+        jobs.insert(jobs.end(), more.begin(), more.end());
+    }
+
+    // Every source is analyzed even if one fails, the clean ones are cached
+    std::string error;
+    try {
+        compileAll(jobs, true);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    size_t offset = 0;
+    for (CompileCpp* cc : targets) {
+        cc->finishAnalysis(jobs, offset);
+        offset += cc->analyzing.size();
+    }
+    if (!error.empty()) {
+        Utils::throwError(error);
+    }
+    std::cout << "ANALYZE SUCCESS" << std::endl;
+}
+
+std::vector<CompileJob> CompileCpp::prepareAnalysis() {
+    init();
+    if (config(compiler + ".analyze", "").empty()) {
+        Utils::throwError("Option -analyze not supported by compiler: " + compiler);
+    }
+    configs["dbDir"] = fileToStr(objDir);
+
+    const std::vector<fs::path>& sources = buildInfo.sources;
+    CmdTemplate compC = compileCmd("comp", "c");
+    CmdTemplate compCpp = compileCmd("comp", "cpp");
+    writeCompileDb(sources, compC, compCpp);
+    CmdTemplate analyzeC = compileCmd("analyze", "c", false);
+    CmdTemplate analyzeCpp = compileCmd("analyze", "cpp", false);
+    requireTool("analyze", analyzeCpp);
+
+    std::vector<std::string> srcKeys;
+    for (const auto& srcFile : sources) {
+        srcKeys.push_back(StatCache::key(srcFile));
+    }
+    scanIncludes(srcKeys);
+    digests.load(objDir / "digests.cache");
+
+    // Key of a source is its analyze and compile commands and the content of every file it includes
+    analyzing.clear();
+    std::vector<CompileJob> jobs;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        fs::path objFile = getObjFile(sources[i]);
+        fs::path report = objFile.generic_string() + ".analysis";
+        bool isC = sources[i].extension() == ".c";
+        std::vector<std::string> args = (isC ? analyzeC : analyzeCpp).fill(sources[i], objFile);
+        std::string cmd = joinArgs(args) + "\n" + joinArgs((isC ? compC : compCpp).fill(sources[i], objFile));
+        uint64_t key = DigestCache::hash(cmd.data(), cmd.size());
+        for (const auto& file : includedFiles(srcKeys[i])) {
+            uint64_t digest = digests.digest(file);
+            key = DigestCache::hash(&digest, sizeof(digest), key);
+        }
+        if (digests.analysis(srcKeys[i]) == key && StatCache::get(StatCache::key(report)).isFile) {
+            continue;
+        }
+        analyzing.emplace_back(srcKeys[i], key);
+        args.insert(args.end(), {">", report.generic_string(), "2>&1"});
+        CompileJob job;
+        job.args = args;
+        job.objFile = report;
+        jobs.push_back(std::move(job));
+    }
+    std::cout << "Analyze " << analyzing.size() << " of " << sources.size() << " sources" << std::endl;
+    return jobs;
+}
+
+void CompileCpp::finishAnalysis(const std::vector<CompileJob>& jobs, size_t offset) {
+    for (size_t i = 0; i < analyzing.size(); ++i) {
+        if (!jobs[offset + i].failed) {
+            digests.recordAnalysis(analyzing[i].first, analyzing[i].second);
+        }
+    }
+    digests.save();
+
+    // Reports of cached sources are printed again, the output doesn't depend on what ran
+    for (const auto& srcFile : buildInfo.sources) {
+        fs::path report = getObjFile(srcFile).generic_string() + ".analysis";
+        std::string text = Utils::readFile(report);
+        if (!text.empty()) {
+            std::cout << text;
+            if (text.back() != '\n') {
+                std::cout << std::endl;
+            }
+        }
+    }
+}
+
+std::vector<std::string> CompileCpp::includedFiles(const std::string& file) const {
+    std::set<std::string> seen = {file};
+    std::vector<std::string> todo = {file};
+    while (!todo.empty()) {
+        std::string next = todo.back();
+        todo.pop_back();
+        auto it = includeMap.find(next);
+        if (it == includeMap.end()) {
+            continue;
+        }
+        for (const auto& dep : it->second) {
+            if (seen.insert(dep).second) {
+                todo.push_back(dep);
             }
         }
+    }
+    return std::vector<std::string>(seen.begin(), seen.end());
+}
+
+// Quoted JSON string
+static std::string jsonStr(const std::string& str) {
+    std::string result = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+void CompileCpp::writeCompileDb(const std::vector<fs::path>& sources, const CmdTemplate& compC, const CmdTemplate& compCpp) {
+    std::string dir = jsonStr(fs::current_path().generic_string());
+    std::ostringstream out;
+    out << "[";
+    for (size_t i = 0; i < sources.size(); ++i) {
+        fs::path objFile = getObjFile(sources[i]);
+        const CmdTemplate& comp = (sources[i].extension() == ".c") ? compC : compCpp;
+        out << (i > 0 ? ",\n" : "\n");
+        out << "  {\"directory\": " << dir << ", \"file\": " << jsonStr(sources[i].generic_string())
+            << ", \"output\": " << jsonStr(objFile.generic_string()) << ", \"arguments\": [";
+        std::vector<std::string> args = comp.fill(sources[i], objFile);
+        for (size_t j = 0; j < args.size(); ++j) {
+            out << (j > 0 ? ", " : "") << jsonStr(args[j]);
+        }
+        out << "]}";
+    }
+    out << "\n]\n";
+
+    fs::path dbFile = objDir.parent_path() / "compile_commands.json";
+    fs::create_directories(objDir);
+    if (!Utils::writeIfChanged(objDir / "compile_commands.json", out.str()) && StatCache::get(StatCache::key(dbFile)).isFile) {
+        return;
+    }
+
+    // Entries of every target in the build directory, where clangd looks for them
+    std::string merged;
+    std::vector<fs::path> dirs;
+    for (const auto& entry : fs::directory_iterator(objDir.parent_path())) {
+        if (entry.is_directory() && entry.path().filename().generic_string().rfind("obj-", 0) == 0) {
+            dirs.push_back(entry.path());
+        }
+    }
+    std::sort(dirs.begin(), dirs.end());
+    for (const auto& objDir : dirs) {
+        std::string text = Utils::readFile(objDir / "compile_commands.json");
+        size_t begin = text.find('[');
+        size_t end = text.rfind(']');
+        if (begin == std::string::npos || end == std::string::npos || text.find('{', begin) > end) {
+            continue;
+        }
+        merged += (merged.empty() ? "" : ",") + text.substr(begin + 1, end - begin - 1);
+    }
+    Utils::writeIfChanged(dbFile, "[" + merged + "]\n");
+}
+
+// Escape text for build.ninja, paths also escape spaces and colons
+static std::string ninjaEscape(const std::string& str, bool path) {
+    std::string result;
+    for (char c : str) {
+        if (c == '$' || (path && (c == ' ' || c == ':'))) {
+            result += '$';
+        }
+        result += c;
+    }
+    return result;
+}
+
+bool CompileCpp::genNinja(const fs::path& dir, const std::string& regenCmd) {
+    linkDir = dir;
+    init();
+    auto path = [](fs::path file) {
+        return ninjaEscape(file.lexically_normal().make_preferred().string(), true);
+    };
+    bool win32 = strcmp(Utils::osName(), "win32") == 0;
+
+    std::ostringstream out;
+    out << "# Generated by fmake -G ninja from " << buildInfo.name << ", edit the build script instead" << std::endl;
+    out << "ninja_required_version = 1.5" << std::endl;
+    out << "builddir = " << path(dir) << std::endl;
+    out << std::endl;
+
+    // Compile rules, the per-TU files become $in and $out
+    std::string depFlags = applyMacros(config(compiler + ".depFlags", ""), {{"depFile", "\x01o.d"}});
+    std::string deps = config(compiler + ".ninjaDeps", "");
+    for (const char* mode : {"c", "cpp"}) {
+        std::string cmd = joinArgs(compileCmd("comp", mode).fill("\x01i", "\x01o"));
+        if (!depFlags.empty()) {
+            cmd += " " + depFlags;
+        }
+        cmd = Utils::replaceAll(Utils::replaceAll(ninjaEscape(cmd, false), "\x01i", "$in"), "\x01o", "$out");
+        out << "rule " << mode << std::endl;
+        out << "  command = " << cmd << std::endl;
+        if (!depFlags.empty() && deps == "gcc") {
+            out << "  depfile = $out.d" << std::endl;
+        }
+        if (!deps.empty()) {
+            out << "  deps = " << deps << std::endl;
+        }
+        out << "  description = Compile $in" << std::endl;
+        out << std::endl;
+    }
+
+    // The linker may leave an unchanged output alone, restat stops the rebuild there
+    out << "rule link" << std::endl;
+    out << "  command = $cmd" << std::endl;
+    out << "  description = Link $out" << std::endl;
+    out << "  restat = 1" << std::endl;
+    out << std::endl;
+
+    out << "rule install" << std::endl;
+    out << "  command = " << (win32 ? "cmd /c copy /y $in $out > nul" : "cp -p $in $out") << std::endl;
+    out << "  description = Install $out" << std::endl;
+    out << std::endl;
+
+    std::vector<fs::path> objFiles;
+    for (const auto& srcFile : buildInfo.sources) {
+        fs::path objFile = getObjFile(srcFile);
+        objFiles.push_back(objFile);
+        out << "build " << path(objFile) << ": " << (srcFile.extension() == ".c" ? "c" : "cpp") << " " << path(srcFile) << std::endl;
+    }
+    out << std::endl;
+
+    // Output of the link is the arg naming outFile or outLibFile, as in /OUT:x.lib
+    std::string name = linkCmdName();
+    std::vector<std::string> args = splitCmd(expandCmd(name));
+    fs::path outBinDir = binDir();
+    std::string outLibStr = (outBinDir / ("lib" + buildInfo.name)).generic_string();
+    fs::path output;
+    for (const auto& arg : args) {
+        size_t pos = arg.find(outLibStr);
+        if (pos == std::string::npos) {
+            pos = arg.find(outFile.generic_string());
+        }
+        if (pos != std::string::npos) {
+            output = arg.substr(pos);
+            break;
+        }
+    }
+    if (output.empty()) {
+        Utils::throwError("No output file in command: " + compiler + "." + name);
+    }
+    std::string linkCmd = joinArgs(args);
+    // ar appends, start from an empty archive
+    if (output.extension() == ".a") {
+        std::string file = output.make_preferred().string();
+        linkCmd = win32 ? "cmd /c if exist \"" + file + "\" del \"" + file + "\" && " + linkCmd
+            : "rm -f \"" + file + "\" && " + linkCmd;
+    }
+    out << "build " << path(output) << ": link";
+    std::sort(objFiles.begin(), objFiles.end());
+    for (const auto& objFile : objFiles) {
+        out << " " << path(objFile);
+    }
+    // Shared depends of -devlink only order the link
+    std::vector<fs::path> libFiles;
+    std::vector<fs::path> sharedFiles;
+    for (const auto& libFile : linkedLibs()) {
+        (devLink && libFile.extension() == ".so" ? sharedFiles : libFiles).push_back(libFile);
+    }
+    if (!libFiles.empty()) {
+        out << " |";
+        for (const auto& libFile : libFiles) {
+            out << " " << path(libFile);
+        }
+    }
+    if (!sharedFiles.empty()) {
+        out << " ||";
+        for (const auto& libFile : sharedFiles) {
+            out << " " << path(libFile);
+        }
+    }
+    out << std::endl;
+    out << "  cmd = " << ninjaEscape(linkCmd, false) << std::endl;
+    out << std::endl;
+
+    // Install edges, meta.props goes last so dependents never see a half installed pod
+    std::vector<std::pair<fs::path, fs::path>> installs = installList(buildInfo.resDirs, outPodDir, false);
+    if (buildInfo.outType != TargetType::exe) {
+        auto headers = installList(buildInfo.installHeaders, includeDir(outPodDir), true);
+        installs.insert(installs.end(), headers.begin(), headers.end());
+        if (buildInfo.installGlobal) {
+            headers = installList(buildInfo.installHeaders, includeDir(buildInfo.outHome), true);
+            installs.insert(installs.end(), headers.begin(), headers.end());
+            installs.emplace_back(output, buildInfo.outHome / "lib/" / output.filename());
+        }
+    }
+    fs::path metaFile = dir / "meta.props";
+    // A regen must not touch meta.props, the install edge would copy it again
+    if (fs::exists(metaFile)) {
+        auto old = Utils::readProps(metaFile);
+        auto it = old.find("pod.buildTime");
+        if (it != old.end()) {
+            meta["pod.buildTime"] = it->second;
+        }
+    }
+    std::ostringstream metaOut;
+    for (const auto& [k, v] : meta) {
+        metaOut << k << "=" << v << std::endl;
+    }
+    Utils::writeIfChanged(metaFile, metaOut.str());
 
-        // Create directory if not exists
+    std::string installed;
+    for (const auto& [from, to] : installs) {
+        out << "build " << path(to) << ": install " << path(from) << std::endl;
+        installed += " " + path(to);
+    }
+    out << "build " << path(outPodDir / "meta.props") << ": install " << path(metaFile) << " | " << path(output) << installed << std::endl;
+    out << "build install: phony " << path(outPodDir / "meta.props") << std::endl;
+    out << "build all: phony " << path(output) << " install" << std::endl;
+    out << "default all" << std::endl;
+    out << std::endl;
+
+    // Parse inputs of the target, a change writes build.ninja again
+    out << "rule regen" << std::endl;
+    out << "  command = " << ninjaEscape(regenCmd, false) << std::endl;
+    out << "  generator = 1" << std::endl;
+    out << "  restat = 1" << std::endl;
+    out << "  description = Regenerate build.ninja" << std::endl;
+    out << "build build.ninja: regen |";
+    std::set<std::string> inputs;
+    std::vector<fs::path> files = buildInfo.inputs;
+    // The tool chain and fmake itself shape every command in the file
+    fs::path exeFile = Utils::exePath();
+    files.push_back(exeFile);
+    files.push_back(exeFile.parent_path() / "tool_chain.props");
+    files.push_back(buildInfo.scriptDir / "tool_chain.props");
+    for (const auto& input : files) {
+        if (fs::exists(input)) {
+            inputs.insert(path(input));
+        }
+    }
+    for (const auto& input : inputs) {
+        out << " " << input;
+    }
+    out << std::endl;
+    return Utils::writeIfChanged(dir / "build.ninja", out.str());
+}
+
+void CompileCpp::analyzeIncludes() {
+    std::cout << "Analyze includes: " << buildInfo.name << " compiler: " << compiler << std::endl;
+    init();
+
+    struct HeaderCost {
+        // Number of TUs including the header
+        size_t fanIn = 0;
+        // File size
+        uintmax_t size = 0;
+        // Bytes of header and everything it includes, largest seen
+        uintmax_t transSize = 0;
+        // Bytes parsed because of the header over all TUs
+        uintmax_t totalBytes = 0;
+        // Parse time from -ftime-trace in milliseconds
+        double parseMs = 0;
+    };
+    std::map<fs::path, HeaderCost> costs;
+    std::map<fs::path, uintmax_t> sizes;
+    bool hasTime = false;
+
+    CmdTemplate includesC = compileCmd("includes", "c");
+    CmdTemplate includesCpp = compileCmd("includes", "cpp");
+    requireTool("analyze-includes", includesCpp);
+
+    for (const auto& srcFile : buildInfo.sources) {
+        fs::path objFile = getObjFile(srcFile);
         fs::create_directories(objFile.parent_path());
+        const CmdTemplate& includes = (srcFile.extension() == ".c") ? includesC : includesCpp;
+        runArgs(includes.fill(srcFile, objFile));
+
+        auto tree = readIncludeTree(objFile.generic_string() + ".inc");
+        std::vector<uintmax_t> transSizes(tree.size(), 0);
+        std::vector<size_t> stack;
+        for (size_t i = 0; i < tree.size(); ++i) {
+            auto sizeIt = sizes.find(tree[i].second);
+            if (sizeIt == sizes.end()) {
+                std::error_code ec;
+                uintmax_t size = fs::file_size(tree[i].second, ec);
+                sizeIt = sizes.emplace(tree[i].second, ec ? 0 : size).first;
+            }
+            while (!stack.empty() && tree[stack.back()].first >= tree[i].first) {
+                stack.pop_back();
+            }
+            // Size counts for the header and all its includers
+            transSizes[i] += sizeIt->second;
+            for (size_t parent : stack) {
+                transSizes[parent] += sizeIt->second;
+            }
+            stack.push_back(i);
+        }
+
+        std::set<fs::path> seen;
+        for (size_t i = 0; i < tree.size(); ++i) {
+            HeaderCost& cost = costs[tree[i].second];
+            if (seen.insert(tree[i].second).second) {
+                cost.fanIn++;
+            }
+            cost.size = sizes[tree[i].second];
+            cost.transSize = std::max(cost.transSize, transSizes[i]);
+            cost.totalBytes += transSizes[i];
+        }
+
+        // clang -ftime-trace writes <obj name>.json next to the object
+        fs::path traceFile = objFile;
+        traceFile.replace_extension(".json");
+        for (const auto& event : TimeTrace::read(traceFile)) {
+            if (event.name == "Source" && !event.detail.empty()) {
+                fs::path header = fs::absolute(event.detail).lexically_normal();
+                costs[header].parseMs += event.dur / 1000.0;
+                hasTime = true;
+            }
+        }
+    }
+
+    std::vector<std::pair<fs::path, HeaderCost>> ranked(costs.begin(), costs.end());
+    std::sort(ranked.begin(), ranked.end(), [hasTime](const auto& a, const auto& b) {
+        if (hasTime && a.second.parseMs != b.second.parseMs) {
+            return a.second.parseMs > b.second.parseMs;
+        }
+        return a.second.totalBytes > b.second.totalBytes;
+    });
+
+    fs::path reportFile = buildInfo.scriptDir / ("../build/includes-" + buildInfo.name + "-" + compiler + "-" + buildInfo.debug + ".txt");
+    std::ofstream ofs(reportFile);
+    ofs << "totalBytes\tfanIn\tsize\ttransSize\tparseMs\theader" << std::endl;
+    for (const auto& [header, cost] : ranked) {
+        ofs << cost.totalBytes << "\t" << cost.fanIn << "\t" << cost.size << "\t" << cost.transSize
+            << "\t" << cost.parseMs << "\t" << header.generic_string() << std::endl;
+    }
+
+    std::cout << std::setw(12) << "totalKB" << std::setw(8) << "fanIn" << std::setw(12) << "transKB";
+    if (hasTime) {
+        std::cout << std::setw(12) << "parseMs";
+    }
+    std::cout << "  header" << std::endl;
+    for (size_t i = 0; i < ranked.size() && i < 30; ++i) {
+        const HeaderCost& cost = ranked[i].second;
+        std::cout << std::setw(12) << cost.totalBytes / 1024 << std::setw(8) << cost.fanIn << std::setw(12) << cost.transSize / 1024;
+        if (hasTime) {
+            std::cout << std::setw(12) << (long)cost.parseMs;
+        }
+        std::cout << "  " << ranked[i].first.generic_string() << std::endl;
+    }
+    std::cout << "Report: " << reportFile.generic_string() << std::endl;
+}
 
-        // Set objFile in configs
-        configs["objFile"] = fileToStr(objFile);
+void CompileCpp::reportTimeTrace() {
+    TimeTrace trace;
+    for (const auto& srcFile : buildInfo.sources) {
+        // clang -ftime-trace writes <obj name>.json next to the object
+        fs::path traceFile = getObjFile(srcFile);
+        traceFile.replace_extension(".json");
+        trace.add(traceFile);
+    }
+    if (trace.count() == 0) {
+        std::cerr << "No time trace found in " << objDir.generic_string() << std::endl;
+        return;
+    }
 
-        // Select macros based on file type
-        if (srcFile.extension() == ".c") {
-            selectMacros("c");
+    fs::path reportFile = buildInfo.scriptDir / ("../build/timetrace-" + buildInfo.name + "-" + compiler + "-" + buildInfo.debug + ".txt");
+    std::ofstream ofs(reportFile);
+    trace.report(ofs, 100);
+    trace.report(std::cout, 10);
+    std::cout << "Report: " << reportFile.generic_string() << std::endl;
+}
+
+std::vector<std::pair<int, fs::path>> CompileCpp::readIncludeTree(const fs::path& logFile) {
+    std::vector<std::pair<int, fs::path>> tree;
+    std::ifstream ifs(logFile);
+    std::string line;
+    const std::string msvcNote = "Note: including file:";
+    while (std::getline(ifs, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        int depth = 0;
+        std::string path;
+        if (!line.empty() && line[0] == '.') {
+            // gcc -H: one dot per level
+            size_t pos = line.find_first_not_of('.');
+            if (pos == std::string::npos || line[pos] != ' ') {
+                continue;
+            }
+            depth = (int)pos;
+            path = line.substr(pos + 1);
+        } else if (line.compare(0, msvcNote.size(), msvcNote) == 0) {
+            // msvc /showIncludes: one space per level
+            size_t pos = line.find_first_not_of(' ', msvcNote.size());
+            if (pos == std::string::npos) {
+                continue;
+            }
+            depth = (int)(pos - msvcNote.size());
+            path = line.substr(pos);
         } else {
-            selectMacros("cpp");
+            continue;
         }
+        tree.emplace_back(depth, fs::absolute(path).lexically_normal());
+    }
+    return tree;
+}
 
-        exeCmd("comp");
+fs::path CompileCpp::profileDir(const std::string& kind) const {
+    return buildInfo.scriptDir / ("../build/" + kind + "-" + buildInfo.name + "-" + compiler);
+}
+
+void CompileCpp::runProfiled(const std::string& kind) {
+    std::string genFlags = config(compiler + "." + kind + "Gen", "");
+    std::string useFlags = config(compiler + "." + kind + "Use", "");
+    if (genFlags.empty() || useFlags.empty()) {
+        Utils::throwError("Option -" + kind + " not supported by compiler: " + compiler);
     }
 
-    // Link
-    if (buildInfo.outType == TargetType::lib) {
-        exeCmd("lib");
+    // init() expands list macros in place, keep a copy for the second build
+    auto savedConfigs = configs;
+    fs::path baseObjDir = objDir;
+    trainDir.clear();
+    fs::path useObjDir = baseObjDir.generic_string() + "-" + kind + "use";
+    fs::path dir = profileDir(kind);
+    configs["profileDir"] = fileToStr(dir);
+
+    if (isProfileStale(dir)) {
+        // Instrumented build in its own objDir
+        objDir = baseObjDir.generic_string() + "-" + kind + "gen";
+        if (fs::exists(objDir)) {
+            // Drop counters of the last training run
+            for (const auto& entry : fs::recursive_directory_iterator(objDir)) {
+                if (entry.path().extension() == ".gcda") {
+                    fs::remove(entry.path());
+                }
+            }
+        }
+        if (fs::exists(dir)) {
+            fs::remove_all(dir);
+        }
+        fs::create_directories(dir);
+
+        if (kind == "layout") {
+            extSources.push_back(genOrderHook(dir));
+        }
+
+        // The instrumented binary never replaces the pod's output, not even if training fails
+        std::cout << kind << ": build instrumented binary" << std::endl;
+        extFlags = genFlags;
+        trainDir = objDir / "bin/";
+        build();
+        extSources.clear();
+
+        std::cout << kind << ": training run" << std::endl;
+        int status = exeBin(trainArgs(kind));
+        trainDir.clear();
+        if (status != 0) {
+            Utils::throwError("Training run failed");
+        }
+        mergeProfile(kind, objDir, dir);
+
+        // Old objects were optimized with an old profile
+        if (fs::exists(useObjDir)) {
+            fs::remove_all(useObjDir);
+        }
+        configs = savedConfigs;
+        configs["profileDir"] = fileToStr(dir);
     } else {
-        exeCmd(buildInfo.outType == TargetType::dll ? "dll" : "exe");
+        std::cout << kind << ": reuse profile " << dir.generic_string() << std::endl;
     }
 
-    // Install
-    install();
+    // Optimized build with profile
+    objDir = useObjDir;
+    fs::create_directories(objDir);
+    copyByExt(dir, objDir, ".gcda");
+    extFlags = useFlags;
+    build();
+}
 
-    std::cout << "BUILD SUCCESS" << std::endl;
+std::string CompileCpp::trainArgs(const std::string& kind) const {
+    if (kind == "layout" && !buildInfo.layoutTrain.empty()) {
+        return buildInfo.layoutTrain;
+    }
+    return buildInfo.pgoTrain;
+}
 
-    // Execute if needed
-    if (buildInfo.execute && buildInfo.outType == TargetType::exe) {
-        exeBin();
+void CompileCpp::requireTool(const std::string& option, const CmdTemplate& cmd) const {
+    if (cmd.args.empty() || cmd.args[0].empty()) {
+        return;
+    }
+    std::string program = cmd.args[0][0].text;
+    Stats::count(Stats::fileStat);
+    bool found = program.find('/') != std::string::npos ? fs::exists(program) : !Utils::findExe(program).empty();
+    if (!found) {
+        Utils::throwError("Option -" + option + " not supported by compiler: " + compiler + ", " + program + " not found");
+    }
+}
+
+bool CompileCpp::isProfileStale(const fs::path& dir) const {
+    fs::path stamp = dir / "profile.props";
+    if (!fs::exists(stamp)) {
+        return true;
+    }
+
+    auto props = Utils::readProps(stamp);
+    auto profTime = fs::last_write_time(stamp);
+    size_t count = 0;
+    auto it = props.find("profile.sources");
+    if (it != props.end()) {
+        count = std::stoul(it->second);
+    }
+
+    // Sources added or removed count as changed
+    size_t total = buildInfo.sources.size();
+    size_t changed = (total > count) ? total - count : count - total;
+    for (const auto& srcFile : buildInfo.sources) {
+        if (fs::last_write_time(srcFile) > profTime) {
+            changed++;
+        }
+    }
+
+    double drift = (total == 0) ? 0 : (double)changed / total;
+    if (drift > buildInfo.pgoDrift) {
+        std::cout << "Profile outdated, " << changed << " of " << total << " sources changed" << std::endl;
+        return true;
+    }
+    return false;
+}
+
+void CompileCpp::mergeProfile(const std::string& kind, const fs::path& genObjDir, const fs::path& dir) {
+    // Compilers with a merge tool (e.g. llvm-profdata) write raw data into profileDir
+    if (!config(compiler + "." + kind + "Merge", "").empty()) {
+        exeCmd(kind + "Merge");
     }
+    // gcc writes .gcda counters next to each object
+    copyByExt(genObjDir, dir, ".gcda");
+
+    if (kind == "layout") {
+        // Keep first call order, one symbol once
+        std::ifstream ifs(dir / "order.raw");
+        std::ofstream symbols(dir / "symbols.txt");
+        std::ofstream sections(dir / "sections.txt");
+        std::set<std::string> seen;
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (line.empty() || !seen.insert(line).second) {
+                continue;
+            }
+            symbols << line << std::endl;
+            sections << ".text." << line << std::endl;
+        }
+    }
+
+    std::ofstream ofs(dir / "profile.props");
+    ofs << "profile.sources=" << buildInfo.sources.size() << std::endl;
+    ofs << "profile.train=" << trainArgs(kind) << std::endl;
+}
+
+fs::path CompileCpp::genOrderHook(const fs::path& dir) {
+    // Record each function on its first call, -finstrument-functions calls the hooks
+    fs::path hookFile = dir / "order_hook.c";
+    std::ofstream ofs(hookFile);
+    ofs << "#define _GNU_SOURCE\n"
+        << "#include <dlfcn.h>\n"
+        << "#include <stdio.h>\n"
+        << "#define SLOTS 65536\n"
+        << "static void* seen[SLOTS];\n"
+        << "static FILE* out;\n"
+        << "__attribute__((no_instrument_function)) void __cyg_profile_func_enter(void* fn, void* site) {\n"
+        << "    (void)site;\n"
+        << "    unsigned long h = ((unsigned long)fn >> 4) % SLOTS;\n"
+        << "    for (int i = 0; i < SLOTS; ++i, h = (h + 1) % SLOTS) {\n"
+        << "        void* cur = __atomic_load_n(&seen[h], __ATOMIC_ACQUIRE);\n"
+        << "        if (cur == fn) return;\n"
+        << "        if (cur == 0 && __atomic_compare_exchange_n(&seen[h], &cur, fn, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;\n"
+        << "        if (cur == fn) return;\n"
+        << "    }\n"
+        << "    Dl_info info;\n"
+        << "    if (!dladdr(fn, &info) || !info.dli_sname) return;\n"
+        << "    if (!out) out = fopen(\"" << (dir / "order.raw").generic_string() << "\", \"a\");\n"
+        << "    if (out) fprintf(out, \"%s\\n\", info.dli_sname);\n"
+        << "}\n"
+        << "__attribute__((no_instrument_function)) void __cyg_profile_func_exit(void* fn, void* site) {\n"
+        << "    (void)fn; (void)site;\n"
+        << "}\n";
+    return hookFile;
+}
 
+void CompileCpp::runBolt() {
+    // BOLT works on ELF binaries only
+    fs::path binFile = outFile;
+    if (buildInfo.outType == TargetType::dll) {
+        binFile = outFile.parent_path() / ("lib" + buildInfo.name + ".so");
+    }
+    fs::path dir = profileDir("layout");
+    fs::create_directories(dir);
+    fs::path preBolt = binFile.generic_string() + ".prebolt";
+    fs::rename(binFile, preBolt);
+
+    configs["binFile"] = fileToStr(preBolt);
+    configs["boltFile"] = fileToStr(binFile);
+    configs["layoutProfile"] = fileToStr(buildInfo.layoutProfile);
+    configs["profileDir"] = fileToStr(dir);
+
+    // Convert the perf data once and keep it
+    fs::path fdata = dir / "perf.fdata";
+    if (!fs::exists(fdata) || fs::last_write_time(buildInfo.layoutProfile) > fs::last_write_time(fdata)) {
+        exeCmd("perf2bolt");
+    }
+    exeCmd("bolt");
+}
+
+void CompileCpp::copyByExt(const fs::path& from, const fs::path& to, const std::string& ext) {
+    if (!fs::is_directory(from)) {
+        return;
+    }
+    for (const auto& entry : fs::recursive_directory_iterator(from)) {
+        if (!fs::is_regular_file(entry) || entry.path().extension() != ext) {
+            continue;
+        }
+        fs::path dstPath = to / fs::relative(entry.path(), from);
+        fs::create_directories(dstPath.parent_path());
+        // Counters are updated in place by training runs, never link them
+        Utils::installFile(entry.path(), dstPath, false);
+    }
 }
 
 std::string CompileCpp::fileToStr(const fs::path& f) {
@@ -261,13 +1291,37 @@ void CompileCpp::clean() {
         if (fs::exists(outPodDir)) {
             fs::remove_all(outPodDir);
         }
+        RepoIndex::remove(buildInfo.outHome, buildInfo.name);
     }
     if (fs::exists(objDir)) {
         fs::remove_all(objDir);
     }
+    for (const std::string kind : {"pgo", "layout"}) {
+        fs::remove_all(objDir.generic_string() + "-" + kind + "gen");
+        fs::remove_all(objDir.generic_string() + "-" + kind + "use");
+    }
     if (fs::exists(outFile)) {
         fs::remove(outFile);
     }
+    // Objects are gone, so are their cached times
+    StatCache::forget();
+}
+
+void CompileCpp::forgetIncludes(const std::vector<std::string>& files) {
+    if (files.empty()) {
+        includeNames.clear();
+    }
+    for (const auto& file : files) {
+        includeNames.erase(file);
+    }
+    for (auto& [key, graph] : includeGraphs) {
+        if (files.empty()) {
+            graph.clear();
+        }
+        for (const auto& file : files) {
+            graph.erase(file);
+        }
+    }
 }
 
 void CompileCpp::fixWin32(std::map<std::string, std::string>& configs_, const std::string& key, const std::string& value) {
@@ -282,28 +1336,24 @@ void CompileCpp::fixWin32(std::map<std::string, std::string>& configs_, const st
     }
 }
 
-void CompileCpp::selectMacros(const std::string& mode) {
-    // Create a copy of configs to iterate over
-    auto configsCopy = configs;
-    
-    for (const auto& [k, v] : configsCopy) {
-        size_t pos = k.find("@{");
-        if (pos != std::string::npos) {
-            size_t endPos = k.find("}", pos + 2);
-            if (endPos != std::string::npos) {
-                std::string macroKey = k.substr(pos + 2, endPos - (pos + 2));
-                if (macroKey == mode) {
-                    std::string newKey = k.substr(0, pos) + k.substr(endPos + 1);
-                    configs[newKey] = v;
-                }
-            }
+void CompileCpp::selectMacros(std::map<std::string, std::string>& configs, const std::string& mode) {
+    // Collect first, inserting while iterating could visit the new keys
+    std::vector<std::pair<std::string, const std::string*>> selected;
+    std::string macro = "@{" + mode + "}";
+    for (const auto& [k, v] : configs) {
+        size_t pos = k.find(macro);
+        if (pos != std::string::npos && k.find("@{") == pos) {
+            selected.emplace_back(k.substr(0, pos) + k.substr(pos + macro.size()), &v);
         }
     }
-    
+    for (const auto& [k, v] : selected) {
+        configs[k] = *v;
+    }
+
     configs["mode"] = mode;
 }
 
-void CompileCpp::applayMacrosForList(const std::map<std::string, std::vector<std::string>>& params) {
+void CompileCpp::applayMacrosForList(std::map<std::string, std::string>& configs, const std::map<std::string, std::vector<std::string>>& params) {
     // Create a copy of configs to iterate over
     auto configsCopy = configs;
     
@@ -370,8 +1420,8 @@ std::string CompileCpp::applyMacros(const std::string& pattern, const std::map<s
             std::string key = result.substr(pos + 2, endPos - (pos + 2));
             auto it = macros.find(key);
             if (it != macros.end()) {
+                // Text before pos is resolved, rescan from pos to handle nested macros
                 result.replace(pos, endPos - pos + 1, it->second);
-                pos = 0; // Reset position to handle nested macros
             } else {
                 pos = endPos + 1;
             }
@@ -384,124 +1434,437 @@ std::string CompileCpp::applyMacros(const std::string& pattern, const std::map<s
 }
 
 void CompileCpp::exeCmd(const std::string& name) {
-    std::string cmd;
-    std::string key = compiler + "." + name;
-    auto it = configs.find(key);
-    if (it != configs.end()) {
-        cmd = it->second;
-    }
+    runArgs(splitCmd(expandCmd(name)));
+}
 
+std::string CompileCpp::expandCmd(const std::string& name) const {
+    std::string key = compiler + "." + name;
+    std::string cmd = config(key, "");
     if (cmd.empty()) {
         Utils::throwError("Command not found in config file: " + key);
     }
 
     cmd = applyMacros(cmd, configs);
-    
+
     // Replace spaces in compHome with ::
     std::string compHomeWithEscapedSpaces = Utils::replaceAll(compHome.generic_string(), " ", "::");
-    cmd = compHomeWithEscapedSpaces + cmd;
+    return compHomeWithEscapedSpaces + cmd;
+}
 
-    // Split command and replace :: with spaces
-    std::vector<std::string> cmds;
-    std::vector<std::string> tcmds = Utils::split(cmd, ' ');
-    for (auto& token : tcmds) {
-        std::string processedToken = Utils::replaceAll(token, "::", " ");
-        // Add quotes around the command if it contains spaces
-        if (processedToken.find(' ') != std::string::npos) {
-            processedToken = "\"" + processedToken + "\"";
+std::vector<fs::path> CompileCpp::linkedLibs() const {
+    std::vector<fs::path> files;
+    for (const auto& name : buildInfo.libs) {
+        bool found = false;
+        for (const auto& dir : buildInfo.libDirs) {
+            for (const auto& file : {"lib" + name + ".a", "lib" + name + ".so", "lib" + name + ".dylib", name}) {
+                std::string key = StatCache::key(dir / file);
+                if (StatCache::get(key).isFile) {
+                    files.push_back(key);
+                    found = true;
+                    break;
+                }
+            }
+            if (found) {
+                break;
+            }
         }
-        cmds.push_back(processedToken);
     }
+    return files;
+}
 
-    // Build command string
-    std::string cmdStr;
-    for (size_t i = 0; i < cmds.size(); ++i) {
-        cmdStr += cmds[i];
-        if (i < cmds.size() - 1) {
-            cmdStr += " ";
-        }
+std::string CompileCpp::linkCmdName() const {
+    if (buildInfo.outType == TargetType::exe) {
+        return "exe";
     }
+    return (buildInfo.outType == TargetType::dll || devLink) ? "dll" : "lib";
+}
 
-    std::cout << "Exec " << cmdStr << std::endl;
+fs::path CompileCpp::binDir() const {
+    if (!trainDir.empty()) {
+        return trainDir;
+    }
+    return outPodDir / ((buildInfo.outType == TargetType::exe) ? "bin/" : "lib/");
+}
 
-    // Execute command
-    int result = std::system(cmdStr.c_str());
-    if (result != 0) {
-        Utils::throwError("Exec failed [" + cmd + "]");
+uint64_t CompileCpp::outputsDigest() const {
+    std::vector<fs::path> files;
+    fs::path outBinDir = binDir();
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(outBinDir, ec)) {
+        files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    if (buildInfo.outType == TargetType::exe && !buildInfo.outBinFile.empty() && trainDir.empty()) {
+        files.push_back(outFile);
     }
 
+    uint64_t digest = 0;
+    for (const auto& file : files) {
+        std::string name = file.generic_string();
+        uint64_t info[2] = {0, 0};
+        if (fs::is_regular_file(file, ec)) {
+            info[0] = (uint64_t)fs::last_write_time(file, ec).time_since_epoch().count();
+            info[1] = (uint64_t)fs::file_size(file, ec);
+        }
+        Stats::count(Stats::fileStat);
+        digest = DigestCache::hash(name.data(), name.size(), digest);
+        digest = DigestCache::hash(info, sizeof(info), digest);
+    }
+    return digest;
 }
 
-void CompileCpp::exeBin() {
-    std::string cmd = outFile.generic_string();
-    std::cout << "Exec " << cmd << std::endl;
-    std::system(cmd.c_str());
-}
+CmdTemplate CompileCpp::compileCmd(const std::string& name, const std::string& mode, bool home) const {
+    std::string key = compiler + "." + name;
+    std::string cmd = config(key, "");
+    if (cmd.empty()) {
+        Utils::throwError("Command not found in config file: " + key);
+    }
 
-fs::path CompileCpp::searchHeaderFile(const fs::path& self, const std::string& name) const {
-    fs::path f = self.parent_path() / name;
-    if (fs::exists(f) && fs::is_regular_file(f)) {
-        return f;
+    // Leave the per-TU macros unresolved
+    auto macros = configs;
+    selectMacros(macros, mode);
+    macros.erase("srcFile");
+    macros.erase("objFile");
+    cmd = applyMacros(cmd, macros);
+    if (home) {
+        cmd = Utils::replaceAll(compHome.generic_string(), " ", "::") + cmd;
     }
 
-    for (const auto& p : buildInfo.incDirs) {
-        f = p / name;
-        if (fs::exists(f) && fs::is_regular_file(f)) {
-            return f;
+    CmdTemplate tmpl;
+    const std::string srcMacro = "@{srcFile}";
+    const std::string objMacro = "@{objFile}";
+    for (const auto& token : Utils::split(cmd, ' ')) {
+        if (token.empty()) {
+            continue;
+        }
+        std::vector<CmdTemplate::Part> parts;
+        size_t pos = 0;
+        while (pos < token.size()) {
+            size_t srcPos = token.find(srcMacro, pos);
+            size_t objPos = token.find(objMacro, pos);
+            size_t next = std::min(srcPos, objPos);
+            if (next == std::string::npos) {
+                next = token.size();
+            }
+            if (next > pos) {
+                parts.push_back({CmdTemplate::literal, Utils::replaceAll(token.substr(pos, next - pos), "::", " ")});
+            }
+            if (next == token.size()) {
+                break;
+            }
+            if (next == srcPos) {
+                parts.push_back({CmdTemplate::srcFile, ""});
+                pos = next + srcMacro.size();
+            } else {
+                parts.push_back({CmdTemplate::objFile, ""});
+                pos = next + objMacro.size();
+            }
         }
+        tmpl.args.push_back(parts);
     }
+    return tmpl;
+}
 
-    return fs::path();
+std::vector<std::string> CmdTemplate::fill(const fs::path& src, const fs::path& obj) const {
+    std::string srcStr = src.generic_string();
+    std::string objStr = obj.generic_string();
+    std::vector<std::string> result;
+    result.reserve(args.size());
+    for (const auto& parts : args) {
+        std::string arg;
+        for (const auto& part : parts) {
+            switch (part.type) {
+                case literal: arg += part.text; break;
+                case srcFile: arg += srcStr; break;
+                case objFile: arg += objStr; break;
+            }
+        }
+        result.push_back(arg);
+    }
+    return result;
 }
 
-bool CompileCpp::isDirty(const fs::path& srcFile_, const std::filesystem::file_time_type& time) {
-    auto srcFile = fs::canonical(srcFile_);
-    auto it = fileDirtyMap.find(srcFile);
-    if (it != fileDirtyMap.end()) {
-        return it->second;
+std::vector<std::string> CompileCpp::splitCmd(const std::string& cmd) {
+    // Split command and replace :: with spaces
+    std::vector<std::string> args;
+    for (const auto& token : Utils::split(cmd, ' ')) {
+        if (!token.empty()) {
+            args.push_back(Utils::replaceAll(token, "::", " "));
+        }
     }
+    return args;
+}
 
-    auto srcTime = fs::last_write_time(srcFile);
-    if (srcTime >= time) {
-        fileDirtyMap[srcFile] = true;
-        return true;
+std::string CompileCpp::joinArgs(const std::vector<std::string>& args) {
+    std::string cmdStr;
+    for (size_t i = 0; i < args.size(); ++i) {
+        // Add quotes around the arg if it contains spaces
+        if (args[i].find(' ') != std::string::npos) {
+            cmdStr += "\"" + args[i] + "\"";
+        } else {
+            cmdStr += args[i];
+        }
+        if (i < args.size() - 1) {
+            cmdStr += " ";
+        }
     }
+    return cmdStr;
+}
 
-    fileDirtyMap[srcFile] = false;
+void CompileCpp::runArgs(const std::vector<std::string>& args) {
+    std::string cmdStr = joinArgs(args);
+    std::cout << "Exec " << cmdStr << std::endl;
 
-    // Check includes
-    std::ifstream ifs(srcFile);
-    if (!ifs.is_open()) {
-        return true;
+    // Execute command
+    Stats::count(Stats::process);
+    int result = std::system(cmdStr.c_str());
+    if (result != 0) {
+        Utils::throwError("Exec failed [" + cmdStr + "]");
+    }
+}
+
+int CompileCpp::exeBin(const std::string& args) {
+    std::string cmd = outFile.generic_string();
+    if (!args.empty()) {
+        cmd += " " + args;
+    }
+    std::cout << "Exec " << cmd << std::endl;
+    Stats::count(Stats::process);
+    return std::system(cmd.c_str());
+}
+
+std::vector<std::string> CompileCpp::readIncludes(const std::string& file, bool& ok, uint64_t& bytes) {
+    std::vector<std::string> names;
+    std::ifstream ifs(file);
+    ok = ifs.is_open();
+    if (!ok) {
+        return names;
     }
 
     std::string line;
     while (std::getline(ifs, line)) {
+        bytes += line.size() + 1;
         std::string trimmed = line;
         trimmed.erase(0, trimmed.find_first_not_of(" \t"));
         if (trimmed.substr(0, 8) == "#include") {
             trimmed = trimmed.substr(8);
             trimmed.erase(0, trimmed.find_first_not_of(" \t"));
             if (trimmed.size() > 2 && trimmed[0] == '"' && trimmed.back() == '"') {
-                std::string includeName = trimmed.substr(1, trimmed.size() - 2);
-                fs::path depend = searchHeaderFile(srcFile, includeName);
-                if (depend.empty()) {
-                    std::cerr << "Not found include file: " << includeName << " in: " << srcFile.generic_string() << std::endl;
-                    continue;
+                names.push_back(trimmed.substr(1, trimmed.size() - 2));
+            }
+        }
+    }
+    return names;
+}
+
+void CompileCpp::scanIncludes(const std::vector<std::string>& files) {
+    std::vector<std::string> level;
+    for (const auto& file : files) {
+        if (includeMap.find(file) == includeMap.end()) {
+            includeMap[file];
+            level.push_back(file);
+        }
+    }
+
+    while (!level.empty()) {
+        // Read all files of the level together, a file read for another graph is not read again
+        std::vector<std::vector<std::string>> names(level.size());
+        std::vector<size_t> unread;
+        for (size_t i = 0; i < level.size(); ++i) {
+            auto it = includeNames.find(level[i]);
+            if (it != includeNames.end()) {
+                names[i] = it->second;
+            } else {
+                unread.push_back(i);
+            }
+        }
+        std::vector<char> readOk(unread.size());
+        std::vector<uint64_t> bytes(unread.size(), 0);
+        Utils::parallelFor(unread.size(), [&](size_t j) {
+            bool ok = false;
+            names[unread[j]] = readIncludes(level[unread[j]], ok, bytes[j]);
+            readOk[j] = ok;
+        });
+        for (size_t j = 0; j < unread.size(); ++j) {
+            if (readOk[j]) {
+                Stats::count(Stats::fileRead);
+                Stats::count(Stats::bytesRead, bytes[j]);
+            }
+            includeNames[level[unread[j]]] = names[unread[j]];
+        }
+
+        // Search path of an include: the including file's directory, then incDirs.
+        // Round k stats the k-th candidate of every unresolved include in one batch.
+        struct Pending {
+            size_t file;
+            std::string name;
+            std::string found;
+        };
+        std::vector<Pending> pending;
+        for (size_t i = 0; i < level.size(); ++i) {
+            for (const auto& name : names[i]) {
+                pending.push_back(Pending{i, name, ""});
+            }
+        }
+        auto candidate = [&](const Pending& p, size_t round) {
+            fs::path dir = (round == 0) ? fs::path(level[p.file]).parent_path() : buildInfo.incDirs[round - 1];
+            return StatCache::key(dir / p.name);
+        };
+        std::vector<size_t> unresolved(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            unresolved[i] = i;
+        }
+        for (size_t round = 0; round <= buildInfo.incDirs.size() && !unresolved.empty(); ++round) {
+            std::vector<std::string> paths;
+            for (size_t i : unresolved) {
+                paths.push_back(candidate(pending[i], round));
+            }
+            StatCache::prefetch(paths);
+
+            std::vector<size_t> rest;
+            for (size_t j = 0; j < unresolved.size(); ++j) {
+                if (StatCache::get(paths[j]).isFile) {
+                    pending[unresolved[j]].found = paths[j];
+                } else {
+                    rest.push_back(unresolved[j]);
                 }
-                depend = fs::canonical(depend);
-                if (isDirty(depend, time)) {
-                    fileDirtyMap[srcFile] = true;
-                    return true;
+            }
+            unresolved.swap(rest);
+        }
+
+        std::vector<std::string> nextLevel;
+        for (const auto& p : pending) {
+            if (p.found.empty()) {
+                std::cerr << "Not found include file: " << p.name << " in: " << level[p.file] << std::endl;
+                continue;
+            }
+            includeMap[level[p.file]].push_back(p.found);
+            if (includeMap.find(p.found) == includeMap.end()) {
+                includeMap[p.found];
+                nextLevel.push_back(p.found);
+            }
+        }
+        level.swap(nextLevel);
+    }
+}
+
+namespace {
+
+// Newest mtime over a file and everything it includes.
+// Include cycles are strongly connected components (Tarjan), every member gets the same time.
+class NewestInput {
+public:
+    NewestInput(const std::map<std::string, std::vector<std::string>>& includes) : includes(includes) {}
+
+    int64_t get(const std::string& file) {
+        auto it = nodes.find(file);
+        if (it == nodes.end()) {
+            visit(file);
+            it = nodes.find(file);
+        }
+        return it->second.newest;
+    }
+
+private:
+    struct Node {
+        int index;
+        int low;
+        bool onStack;
+        int64_t newest;
+    };
+
+    const std::map<std::string, std::vector<std::string>>& includes;
+    std::map<std::string, Node> nodes;
+    std::vector<std::string> stack;
+    int counter = 0;
+
+    void visit(const std::string& file) {
+        const StatCache::Info& info = StatCache::get(file);
+        // Unreadable file, always rebuild
+        int64_t mtime = info.isFile ? info.mtime : INT64_MAX;
+        nodes[file] = Node{counter, counter, true, mtime};
+        counter++;
+        stack.push_back(file);
+
+        auto it = includes.find(file);
+        if (it != includes.end()) {
+            for (const auto& dep : it->second) {
+                auto found = nodes.find(dep);
+                if (found == nodes.end()) {
+                    visit(dep);
+                    Node& d = nodes[dep];
+                    Node& n = nodes[file];
+                    n.low = std::min(n.low, d.low);
+                    n.newest = std::max(n.newest, d.newest);
+                } else if (found->second.onStack) {
+                    Node& n = nodes[file];
+                    n.low = std::min(n.low, found->second.index);
+                } else {
+                    Node& n = nodes[file];
+                    n.newest = std::max(n.newest, found->second.newest);
                 }
             }
         }
+
+        Node& n = nodes[file];
+        if (n.low == n.index) {
+            // Pop the component, all members share the newest time
+            size_t start = stack.size();
+            int64_t newest = INT64_MIN;
+            do {
+                --start;
+                newest = std::max(newest, nodes[stack[start]].newest);
+            } while (stack[start] != file);
+            for (size_t i = start; i < stack.size(); ++i) {
+                Node& m = nodes[stack[i]];
+                m.onStack = false;
+                m.newest = newest;
+            }
+            stack.resize(start);
+        }
     }
+};
 
-    return false;
+}
+
+std::vector<fs::path> CompileCpp::dirtySources(const std::vector<fs::path>& sources) {
+    std::vector<std::string> srcKeys;
+    std::vector<std::string> objKeys;
+    std::vector<std::string> paths;
+    for (const auto& srcFile : sources) {
+        srcKeys.push_back(StatCache::key(srcFile));
+        objKeys.push_back(StatCache::key(getObjFile(srcFile)));
+        paths.push_back(srcKeys.back());
+        paths.push_back(objKeys.back());
+    }
+    StatCache::prefetch(paths);
+
+    // Only sources older than their object need the include scan
+    std::vector<char> dirty(sources.size(), 0);
+    std::vector<std::string> check;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const StatCache::Info& obj = StatCache::get(objKeys[i]);
+        const StatCache::Info& src = StatCache::get(srcKeys[i]);
+        if (!obj.isFile || !src.isFile || src.mtime >= obj.mtime) {
+            dirty[i] = 1;
+        } else {
+            check.push_back(srcKeys[i]);
+        }
+    }
+    scanIncludes(check);
+
+    NewestInput newest(includeMap);
+    std::vector<fs::path> result;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (dirty[i] || newest.get(srcKeys[i]) >= StatCache::get(objKeys[i]).mtime) {
+            result.push_back(sources[i]);
+        }
+    }
+    return result;
 }
 
 void CompileCpp::install() {
+    Stats::Phase phase("install");
     // Copy resources
     if (!buildInfo.resDirs.empty()) {
         copyInto(buildInfo.resDirs, outPodDir, false, true);
@@ -520,39 +1883,52 @@ void CompileCpp::install() {
             fs::path srcLibDir = outPodDir / "lib/";
             if (fs::exists(srcLibDir)) {
                 for (const auto& entry : fs::directory_iterator(srcLibDir)) {
-                    fs::copy(entry.path(), libDirs / entry.path().filename(), fs::copy_options::overwrite_existing);
+                    if (entry.is_regular_file()) {
+                        // Link output, the linker replaces it instead of writing into it
+                        Utils::installFile(entry.path(), libDirs / entry.path().filename(), true);
+                    } else {
+                        fs::copy(entry.path(), libDirs / entry.path().filename(), fs::copy_options::overwrite_existing | fs::copy_options::recursive);
+                    }
                 }
             }
         }
     }
 
-    // Write meta.props
+    // Write meta.props, a skipped link keeps the pod as it was so dependents stop here
     fs::path metaPath = outPodDir / "meta.props";
-    std::ofstream ofs(metaPath);
-    if (ofs.is_open()) {
-        for (const auto& [k, v] : meta) {
-            ofs << k << "=" << v << std::endl;
+    if (!linked && fs::exists(metaPath)) {
+        auto old = Utils::readProps(metaPath);
+        auto it = old.find("pod.buildTime");
+        if (it != old.end()) {
+            meta["pod.buildTime"] = it->second;
         }
-        ofs.close();
     }
+    std::ostringstream out;
+    for (const auto& [k, v] : meta) {
+        out << k << "=" << v << std::endl;
+    }
+    Utils::writeIfChanged(metaPath, out.str());
+    RepoIndex::update(buildInfo.outHome, meta, outPodDir / "lib/");
 
     std::cout << "outFile: " << outFile.generic_string() << std::endl;
 }
 
-void CompileCpp::copyHeaderFile(const fs::path& outDir) {
-    fs::path dstIncludeDir;
+fs::path CompileCpp::includeDir(const fs::path& outDir) const {
     if (!buildInfo.includeDst.empty()) {
-        dstIncludeDir = outDir / "include/" / buildInfo.includeDst;
-    } else {
-        dstIncludeDir = outDir / "include/";
+        return outDir / "include/" / buildInfo.includeDst;
     }
+    return outDir / "include/";
+}
+
+void CompileCpp::copyHeaderFile(const fs::path& outDir) {
+    fs::path dstIncludeDir = includeDir(outDir);
     fs::create_directories(dstIncludeDir);
 
     copyInto(buildInfo.installHeaders, dstIncludeDir, true, true);
 }
 
-void CompileCpp::copyInto(const std::vector<fs::path>& src, const fs::path& dir, bool filter, bool overwrite) {
-
+std::vector<std::pair<fs::path, fs::path>> CompileCpp::installList(const std::vector<fs::path>& src, const fs::path& dir, bool filter) {
+    std::vector<std::pair<fs::path, fs::path>> result;
     for (const auto& uri : src) {
         fs::path f = uri;
         fs::path dst = dir;
@@ -571,24 +1947,27 @@ void CompileCpp::copyInto(const std::vector<fs::path>& src, const fs::path& dir,
                 if (!fs::is_directory(entry)) {
                     std::string ext = entry.path().extension().generic_string();
                     if (!filter || ext == ".h" || ext == ".hpp" || ext == ".inl") {
-                        fs::create_directories(dstPath.parent_path());
-                        if (overwrite || !fs::exists(dstPath)) {
-                            fs::copy(entry.path(), dstPath, fs::copy_options::overwrite_existing);
-                        }
+                        result.emplace_back(entry.path(), dstPath);
                     }
                 }
             }
         } else {
-            if (overwrite || !fs::exists(dst)) {
-                fs::create_directories(dst);
-                fs::path dstPath = dst / f.filename();
-                std::string ext = f.extension().generic_string();
-                if (!filter || ext == ".h" || ext == ".hpp" || ext == ".inl") {
-                    fs::copy(f, dstPath, fs::copy_options::overwrite_existing);
-                }
+            std::string ext = f.extension().generic_string();
+            if (!filter || ext == ".h" || ext == ".hpp" || ext == ".inl") {
+                result.emplace_back(f, dst / f.filename());
             }
         }
     }
+    return result;
+}
+
+void CompileCpp::copyInto(const std::vector<fs::path>& src, const fs::path& dir, bool filter, bool overwrite) {
+    for (const auto& [from, to] : installList(src, dir, filter)) {
+        if (overwrite || !fs::exists(to)) {
+            fs::create_directories(to.parent_path());
+            Utils::installFile(from, to, false);
+        }
+    }
 }
 
 
@@ -6,9 +6,35 @@
 #include <map>
 
 #include "BuildCpp.h"
+#include "DigestCache.h"
 
 namespace fs = std::filesystem;
 
+// Command with the constant parts expanded once per target
+struct CmdTemplate {
+    enum PartType { literal, srcFile, objFile };
+
+    struct Part {
+        PartType type;
+        std::string text;
+    };
+
+    // Each arg is a list of parts
+    std::vector<std::vector<Part>> args;
+
+    // Fill in the per-TU files
+    std::vector<std::string> fill(const fs::path& src, const fs::path& obj) const;
+};
+
+// One object to compile
+struct CompileJob {
+    std::vector<std::string> args;
+    fs::path objFile;
+    bool failed = false;
+    // Command without the object file, the same TU of another target has the same key. Empty to never share.
+    std::string key;
+};
+
 class CompileCpp {
 private:
     // Output file name
@@ -23,6 +49,10 @@ private:
     // Build information
     const BuildCpp& buildInfo;
 
+    // Quoted includes of each scanned file, resolved to StatCache keys.
+    // Shared by targets with the same incDirs and kept for the life of the process.
+    std::map<std::string, std::vector<std::string>>& includeMap;
+
     // Version
     std::string version;
 
@@ -38,8 +68,35 @@ private:
     // Configs.props
     std::map<std::string, std::string> configs;
 
-    // File dirty map
-    std::map<fs::path, bool> fileDirtyMap;
+    // Configs before init() expanded them, for another run
+    std::map<std::string, std::string> baseConfigs;
+
+    // Extra flags appended to cflags, cppflags and linkflags
+    std::string extFlags;
+
+    // Extra sources of instrumented build
+    std::vector<fs::path> extSources;
+
+    // Run llvm-bolt after link
+    bool bolt;
+
+    // Debug build of -devlink, library pods link as shared objects with rpaths into the repo
+    bool devLink;
+
+    // The last link() ran the linker, false if it was up to date
+    bool linked;
+
+    // Output directory of an instrumented build, empty for the pod's bin/ or lib/
+    fs::path trainDir;
+
+    // Digests of objects and linked libraries, decides if the link can be skipped
+    DigestCache digests;
+
+    // Directory the link runs in, objList is relative to it. Empty for the current directory.
+    fs::path linkDir;
+
+    // Sources of the running -analyze and their cache keys, in job order
+    std::vector<std::pair<std::string, uint64_t>> analyzing;
 
 public:
     // Constructor
@@ -48,34 +105,161 @@ public:
     // Run the compiler
     void run();
 
+    // Build targets together, the compiles of all plain builds share one scheduler
+    static void runAll(const std::vector<CompileCpp*>& targets);
+
+    // Run again after files changed, only the includes of changed files are read again
+    void rerun(const std::vector<fs::path>& changed);
+
+    // Sources and all headers they include
+    std::vector<fs::path> inputFiles() const;
+
     // Clean build files
     void clean();
 
+    // Drop scanned includes of changed files, or of every file if empty
+    static void forgetIncludes(const std::vector<std::string>& files = {});
+
+    // Report header cost of include graph
+    void analyzeIncludes();
+
+    // Run the analyzer over the changed sources of all targets on one job pool
+    static void analyzeAll(const std::vector<CompileCpp*>& targets);
+
+    // Write dir/build.ninja with the tool chain commands, regenCmd writes it again.
+    // Returns false if build.ninja was already up to date.
+    bool genNinja(const fs::path& dir, const std::string& regenCmd);
+
+    // Select macros
+    static void selectMacros(std::map<std::string, std::string>& configs, const std::string& mode);
+
+    // Apply macros for list
+    static void applayMacrosForList(std::map<std::string, std::string>& configs, const std::map<std::string, std::vector<std::string>>& params);
+
+    // Apply macros
+    static std::string applyMacros(const std::string& pattern, const std::map<std::string, std::string>& macros);
+
 private:
     // Initialize
     void init();
 
+    // Compile and link
+    void build();
+
+    // Initialize and find the objects to compile
+    std::vector<CompileJob> prepare();
+
+    // Run compile jobs on all cores, stop at the first failure unless keepGoing
+    static void compileAll(std::vector<CompileJob>& jobs, bool keepGoing = false);
+
+    // Analyzer jobs of sources whose content, headers or commands changed since the last clean run
+    std::vector<CompileJob> prepareAnalysis();
+
+    // Record clean analyses and print the reports
+    void finishAnalysis(const std::vector<CompileJob>& jobs, size_t offset);
+
+    // Write compile_commands.json of the target and of the build directory
+    void writeCompileDb(const std::vector<fs::path>& sources, const CmdTemplate& compC, const CmdTemplate& compCpp);
+
+    // A file and everything it includes, sorted
+    std::vector<std::string> includedFiles(const std::string& file) const;
+
+    // Link the objects
+    void link();
+
+    // Steps after link, install
+    void finish();
+
+    // Profile kind of a profiled build, empty for a plain build
+    std::string profiled() const;
+
+    // Profile directory of pgo or layout
+    fs::path profileDir(const std::string& kind) const;
+
+    // Profiled build: instrument, train, rebuild with profile
+    void runProfiled(const std::string& kind);
+
+    // Arguments of the training run of a profiled build
+    std::string trainArgs(const std::string& kind) const;
+
+    // Fail with a clear error if the program of a command is not installed
+    void requireTool(const std::string& option, const CmdTemplate& cmd) const;
+
+    // Check if the stored profile is missing or too old
+    bool isProfileStale(const fs::path& dir) const;
+
+    // Collect profile data from instrumented build
+    void mergeProfile(const std::string& kind, const fs::path& genObjDir, const fs::path& dir);
+
+    // Write function order hook source
+    static fs::path genOrderHook(const fs::path& dir);
+
+    // Optimize linked binary with llvm-bolt
+    void runBolt();
+
+    // Merge -ftime-trace files of objects into one report
+    void reportTimeTrace();
+
     // Get object file path
     fs::path getObjFile(const fs::path& srcFile) const;
 
     // Execute command
     void exeCmd(const std::string& name);
 
+    // Expand a configured command
+    std::string expandCmd(const std::string& name) const;
+
+    // Library files in libDirs the link resolves libNames to
+    std::vector<fs::path> linkedLibs() const;
+
+    // Command that links the target: lib, dll or exe
+    std::string linkCmdName() const;
+
+    // Directory the link writes to
+    fs::path binDir() const;
+
+    // Names, times and sizes of the link outputs
+    uint64_t outputsDigest() const;
+
+    // Expand a command except srcFile and objFile, tools outside the tool chain have no compHome
+    CmdTemplate compileCmd(const std::string& name, const std::string& mode, bool home = true) const;
+
+    // Split expanded command into args
+    static std::vector<std::string> splitCmd(const std::string& cmd);
+
+    // Command line of args
+    static std::string joinArgs(const std::vector<std::string>& args);
+
+    // Execute args
+    static void runArgs(const std::vector<std::string>& args);
+
     // Execute binary
-    void exeBin();
+    int exeBin(const std::string& args = "");
+
+    // Copy files with extension, keep relative path
+    static void copyByExt(const fs::path& from, const fs::path& to, const std::string& ext);
 
-    // Check if file is dirty
-    bool isDirty(const fs::path& srcFile, const std::filesystem::file_time_type& time);
+    // Sources newer than their object, including changed headers
+    std::vector<fs::path> dirtySources(const std::vector<fs::path>& sources);
 
-    // Search header file
-    fs::path searchHeaderFile(const fs::path& self, const std::string& name) const;
+    // Read and resolve includes of files and all headers they reach, level by level
+    void scanIncludes(const std::vector<std::string>& files);
+
+    // Quoted include names of a file, thread safe
+    static std::vector<std::string> readIncludes(const std::string& file, bool& ok, uint64_t& bytes);
 
     // Install
     void install();
 
+    // Header install directory of a pod or global directory
+    fs::path includeDir(const fs::path& outDir) const;
+
     // Copy header files
     void copyHeaderFile(const fs::path& outDir);
 
+    // Source and destination of every file copyInto installs
+    static std::vector<std::pair<fs::path, fs::path>> installList(const std::vector<fs::path>& src, const fs::path& dir, bool flatten);
+
     // Copy into directory
     static void copyInto(const std::vector<fs::path>& src, const fs::path& dir, bool flatten, bool overwrite);
 
@@ -85,15 +269,9 @@ private:
     // Fix win32 paths
     void fixWin32(std::map<std::string, std::string>& configs, const std::string& key, const std::string& value);
 
-    // Select macros
-    void selectMacros(const std::string& mode);
-
-    // Apply macros for list
-    void applayMacrosForList(const std::map<std::string, std::vector<std::string>>& params);
-
-    // Apply macros
-    std::string applyMacros(const std::string& pattern, const std::map<std::string, std::string>& macros);
-
     // File to string
     static std::string fileToStr(const fs::path& f);
+
+    // Parse include tree printed by compiler, returns depth and header path
+    static std::vector<std::pair<int, fs::path>> readIncludeTree(const fs::path& logFile);
 };
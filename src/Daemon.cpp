@@ -0,0 +1,462 @@
+#include "Daemon.h"
+#include "Utils.h"
+#include "Stats.h"
+#include "StatCache.h"
+#include "CompileCpp.h"
+#include "Watcher.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <map>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+
+extern char** environ;
+#endif
+
+// Most sockets live in /tmp, sun_path only holds about 100 bytes
+fs::path Daemon::socketPath(const fs::path& scriptFile) {
+    std::string workspace = StatCache::key(fs::absolute(scriptFile).parent_path() / "../build");
+    // FNV-1a, stable across builds of fmake
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : workspace) {
+        hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+    }
+    char name[64];
+#ifdef _WIN32
+    snprintf(name, sizeof(name), "fmake-%016llx.sock", (unsigned long long)hash);
+#else
+    snprintf(name, sizeof(name), "fmake-%u-%016llx.sock", (unsigned)getuid(), (unsigned long long)hash);
+#endif
+    return fs::temp_directory_path() / name;
+}
+
+#ifdef _WIN32
+
+bool Daemon::forward(const fs::path&, const std::vector<std::string>&, int&) {
+    return false;
+}
+
+int Daemon::serve(const fs::path&, const Command&) {
+    Utils::throwError("Daemon needs Unix domain sockets, not supported on Windows");
+    return 1;
+}
+
+void Daemon::invalidate(Watcher&, bool&) {
+}
+
+void Daemon::watchCaches(Watcher&, std::set<std::string>&, bool&) {
+}
+
+#else
+
+// Request: cwd, environment and args, sent with the client's stdin, stdout and stderr
+struct Request {
+    std::string cwd;
+    std::vector<std::string> env;
+    std::vector<std::string> args;
+    int fds[3] = {-1, -1, -1};
+};
+
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size) {
+    char* p = (char*)data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void putStr(std::string& out, const std::string& str) {
+    uint32_t size = (uint32_t)str.size();
+    out.append((const char*)&size, sizeof(size));
+    out += str;
+}
+
+static bool getStr(const std::string& in, size_t& pos, std::string& str) {
+    uint32_t size;
+    if (pos + sizeof(size) > in.size()) {
+        return false;
+    }
+    memcpy(&size, in.data() + pos, sizeof(size));
+    pos += sizeof(size);
+    if (pos + size > in.size()) {
+        return false;
+    }
+    str.assign(in, pos, size);
+    pos += size;
+    return true;
+}
+
+static bool getList(const std::string& in, size_t& pos, std::vector<std::string>& list) {
+    std::string count;
+    if (!getStr(in, pos, count)) {
+        return false;
+    }
+    // Each string takes at least its size field
+    unsigned long size = strtoul(count.c_str(), nullptr, 10);
+    if (size > in.size()) {
+        return false;
+    }
+    list.resize(size);
+    for (auto& str : list) {
+        if (!getStr(in, pos, str)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int connectTo(const fs::path& socketFile) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::string path = socketFile.string();
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Payload size first, the three descriptors ride along with it
+static bool sendRequest(int fd, const std::string& payload) {
+    uint32_t size = (uint32_t)payload.size();
+    int fds[3] = {0, 1, 2};
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+    struct iovec iov = {&size, sizeof(size)};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (sendmsg(fd, &msg, 0) != (ssize_t)sizeof(size)) {
+        return false;
+    }
+    return writeAll(fd, payload.data(), payload.size());
+}
+
+static bool receiveRequest(int fd, Request& request) {
+    uint32_t size = 0;
+    char control[CMSG_SPACE(sizeof(request.fds))] = {};
+    struct iovec iov = {&size, sizeof(size)};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, 0) != (ssize_t)sizeof(size)) {
+        return false;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(request.fds))) {
+        return false;
+    }
+    memcpy(request.fds, CMSG_DATA(cmsg), sizeof(request.fds));
+
+    std::string payload(size, '\0');
+    size_t pos = 0;
+    return readAll(fd, payload.data(), size) && getStr(payload, pos, request.cwd)
+        && getList(payload, pos, request.env) && getList(payload, pos, request.args);
+}
+
+bool Daemon::forward(const fs::path& scriptFile, const std::vector<std::string>& args, int& status) {
+    int fd = connectTo(socketPath(scriptFile));
+    if (fd < 0) {
+        return false;
+    }
+
+    std::string payload;
+    putStr(payload, fs::current_path().string());
+    std::vector<std::string> env;
+    for (char** e = environ; *e; ++e) {
+        env.push_back(*e);
+    }
+    const std::vector<std::string>* lists[] = {&env, &args};
+    for (const auto* list : lists) {
+        putStr(payload, std::to_string(list->size()));
+        for (const auto& str : *list) {
+            putStr(payload, str);
+        }
+    }
+
+    // Output goes straight to our descriptors, the socket only carries the exit status
+    int32_t result = 1;
+    if (!sendRequest(fd, payload)) {
+        close(fd);
+        return false;
+    }
+    if (!readAll(fd, &result, sizeof(result))) {
+        std::cerr << "Error: fmake daemon stopped during the build" << std::endl;
+        result = 1;
+    }
+    close(fd);
+    status = result;
+    return true;
+}
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onStop(int) {
+    stopping = 1;
+}
+
+// Replace the environment with the client's, compilers and FMAKE_REPO come from it
+static void setEnvironment(const std::vector<std::string>& env) {
+    std::vector<std::string> names;
+    for (char** e = environ; *e; ++e) {
+        std::string var = *e;
+        names.push_back(var.substr(0, var.find('=')));
+    }
+    for (const auto& name : names) {
+        unsetenv(name.c_str());
+    }
+    for (const auto& var : env) {
+        size_t pos = var.find('=');
+        if (pos != std::string::npos && pos > 0) {
+            setenv(var.substr(0, pos).c_str(), var.c_str() + pos + 1, 1);
+        }
+    }
+}
+
+static int runRequest(Request& request, const Daemon::Command& command) {
+    int saved[3];
+    for (int i = 0; i < 3; ++i) {
+        saved[i] = dup(i);
+        dup2(request.fds[i], i);
+        close(request.fds[i]);
+    }
+    fs::path home = fs::current_path();
+    setEnvironment(request.env);
+    Stats::reset();
+
+    int status = 1;
+    try {
+        fs::current_path(request.cwd);
+        status = command(request.args);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; ++i) {
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+    std::error_code ec;
+    fs::current_path(home, ec);
+    return status;
+}
+
+void Daemon::invalidate(Watcher& watcher, bool& watching) {
+    if (!watching) {
+        StatCache::forget();
+        CompileCpp::forgetIncludes();
+        return;
+    }
+
+    std::vector<std::string> modified;
+    std::vector<std::string> replaced;
+    bool resolve = false;
+    for (const auto& change : watcher.pending()) {
+        if (change.type == Watcher::lost) {
+            watching = false;
+            invalidate(watcher, watching);
+            return;
+        }
+        std::string key = StatCache::key(change.path);
+        if (change.type == Watcher::modified) {
+            modified.push_back(key);
+            continue;
+        }
+        replaced.push_back(key);
+        // A new or removed header, or directory, can change what an include resolves to
+        static const std::set<std::string> exts = {".h", ".hpp", ".hh", ".hxx", ".inl", ".ipp", ".tpp", ""};
+        if (exts.count(change.path.extension().generic_string())) {
+            resolve = true;
+        }
+    }
+    // Empty lists mean everything to forget()
+    modified.insert(modified.end(), replaced.begin(), replaced.end());
+    if (modified.empty()) {
+        return;
+    }
+    StatCache::forget(modified);
+    StatCache::forgetUnder(replaced);
+    if (resolve) {
+        CompileCpp::forgetIncludes();
+    } else {
+        CompileCpp::forgetIncludes(modified);
+    }
+}
+
+void Daemon::watchCaches(Watcher& watcher, std::set<std::string>& dirs, bool& watching) {
+    // Directory of each cached path, or its nearest existing parent for a path that is not there yet
+    std::set<std::string> wanted;
+    std::map<std::string, std::string> existing;
+    for (const auto& key : StatCache::paths()) {
+        std::string dir = fs::path(key).parent_path().generic_string();
+        auto it = existing.find(dir);
+        if (it == existing.end()) {
+            fs::path found = dir;
+            while (!fs::is_directory(found) && found.has_relative_path()) {
+                found = found.parent_path();
+            }
+            it = existing.emplace(dir, found.generic_string()).first;
+        }
+        wanted.insert(it->second);
+    }
+
+    std::vector<fs::path> list(wanted.begin(), wanted.end());
+    watching = watcher.watch(list, {});
+
+    // Paths stat'ed before their directory was watched may have changed in between, check them once
+    std::vector<std::string> fresh;
+    for (const auto& key : StatCache::paths()) {
+        auto it = existing.find(fs::path(key).parent_path().generic_string());
+        if (it != existing.end() && dirs.find(it->second) == dirs.end()) {
+            fresh.push_back(key);
+        }
+    }
+    std::vector<StatCache::Info> before;
+    for (const auto& key : fresh) {
+        before.push_back(StatCache::get(key));
+    }
+    if (fresh.empty()) {
+        dirs.swap(wanted);
+        return;
+    }
+    StatCache::forget(fresh);
+    StatCache::prefetch(fresh);
+    std::vector<std::string> changed;
+    for (size_t i = 0; i < fresh.size(); ++i) {
+        const StatCache::Info& now = StatCache::get(fresh[i]);
+        if (now.exists != before[i].exists || now.mtime != before[i].mtime) {
+            changed.push_back(fresh[i]);
+        }
+    }
+    if (!changed.empty()) {
+        CompileCpp::forgetIncludes();
+    }
+    dirs.swap(wanted);
+}
+
+int Daemon::serve(const fs::path& scriptFile, const Command& command) {
+    fs::path socketFile = socketPath(scriptFile);
+    int existing = connectTo(socketFile);
+    if (existing >= 0) {
+        close(existing);
+        Utils::throwError("Daemon already running: " + socketFile.string());
+    }
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::string path = socketFile.string();
+    if (path.size() >= sizeof(addr.sun_path)) {
+        Utils::throwError("Socket path too long: " + path);
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // A stale socket of a daemon that was killed
+    std::error_code ec;
+    fs::remove(socketFile, ec);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        Utils::throwError("Listen on " + path + " failed: " + strerror(errno));
+    }
+    // The client hands over its terminal, only its own user may connect
+    chmod(path.c_str(), S_IRUSR | S_IWUSR);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    struct sigaction action = {};
+    action.sa_handler = onStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    // A client that went away must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    std::cout << "Daemon listening on " << path << ", Ctrl+C to stop" << std::endl;
+    Watcher watcher;
+    std::set<std::string> dirs;
+    bool watching = false;
+    while (!stopping) {
+        int conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        fcntl(conn, F_SETFD, FD_CLOEXEC);
+
+        Request request;
+        if (receiveRequest(conn, request)) {
+            invalidate(watcher, watching);
+            int32_t status = runRequest(request, command);
+            watchCaches(watcher, dirs, watching);
+            writeAll(conn, &status, sizeof(status));
+        } else {
+            for (int reqFd : request.fds) {
+                if (reqFd >= 0) {
+                    close(reqFd);
+                }
+            }
+        }
+        close(conn);
+    }
+
+    close(fd);
+    fs::remove(socketFile, ec);
+    std::cout << "Daemon stopped" << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+class Watcher;
+
+// Background process of a workspace that keeps the stat cache, include graphs and
+// directory listings in memory. fmake forwards its command line over a Unix domain
+// socket, the daemon runs it with the client's stdin, stdout, stderr and environment.
+class Daemon {
+public:
+    // Runs one command line, returns the exit status
+    typedef std::function<int(const std::vector<std::string>&)> Command;
+
+    /**
+     * Socket of the workspace a script builds in, scripts sharing ../build share a daemon
+     */
+    static fs::path socketPath(const fs::path& scriptFile);
+
+    /**
+     * Run a command line in the daemon, false if no daemon is running
+     */
+    static bool forward(const fs::path& scriptFile, const std::vector<std::string>& args, int& status);
+
+    /**
+     * Serve the workspace of a script until SIGINT or SIGTERM
+     */
+    static int serve(const fs::path& scriptFile, const Command& command);
+
+private:
+    // Drop cached state of files changed since the last command
+    static void invalidate(Watcher& watcher, bool& watching);
+
+    // Watch the directories of every cached path
+    static void watchCaches(Watcher& watcher, std::set<std::string>& dirs, bool& watching);
+};
@@ -0,0 +1,158 @@
+#include "DigestCache.h"
+#include "CacheFile.h"
+#include "StatCache.h"
+#include "Stats.h"
+#include <fstream>
+#include <cstring>
+
+static const uint32_t cacheVersion = 2;
+
+void DigestCache::load(const fs::path& file) {
+    cacheFile = file;
+    entries.clear();
+    analyses.clear();
+    linkInputs = 0;
+    linkOutputs = 0;
+    dirty = false;
+
+    CacheReader r;
+    if (!r.load(file)) {
+        return;
+    }
+    try {
+        if (r.u64() != cacheVersion) {
+            return;
+        }
+        linkInputs = r.u64();
+        linkOutputs = r.u64();
+        uint64_t count = r.count();
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string key = r.str();
+            Entry& entry = entries[key];
+            entry.mtime = (int64_t)r.u64();
+            entry.size = r.u64();
+            entry.digest = r.u64();
+        }
+        count = r.count();
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string src = r.str();
+            analyses[src] = r.u64();
+        }
+    } catch (const std::exception&) {
+        entries.clear();
+        analyses.clear();
+        linkInputs = 0;
+        linkOutputs = 0;
+    }
+}
+
+void DigestCache::save() {
+    if (!dirty || cacheFile.empty()) {
+        return;
+    }
+    CacheWriter w;
+    w.u64(cacheVersion);
+    w.u64(linkInputs);
+    w.u64(linkOutputs);
+    w.u64(entries.size());
+    for (const auto& [key, entry] : entries) {
+        w.str(key);
+        w.u64((uint64_t)entry.mtime);
+        w.u64(entry.size);
+        w.u64(entry.digest);
+    }
+    w.u64(analyses.size());
+    for (const auto& [src, key] : analyses) {
+        w.str(src);
+        w.u64(key);
+    }
+    w.save(cacheFile);
+    dirty = false;
+}
+
+uint64_t DigestCache::digest(const fs::path& file) {
+    std::string key = StatCache::key(file);
+    const StatCache::Info& info = StatCache::get(key);
+    if (!info.isFile) {
+        return 0;
+    }
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.mtime == info.mtime && it->second.size == info.size) {
+        return it->second.digest;
+    }
+
+    Entry entry;
+    entry.mtime = info.mtime;
+    entry.size = info.size;
+    if (!hashFile(file, entry.digest)) {
+        return 0;
+    }
+    Stats::count(Stats::fileRead);
+    Stats::count(Stats::bytesRead, entry.size);
+    entries[key] = entry;
+    dirty = true;
+    return entry.digest;
+}
+
+bool DigestCache::linkUpToDate(uint64_t inputs, uint64_t outputs) const {
+    return linkInputs != 0 && linkInputs == inputs && linkOutputs == outputs;
+}
+
+void DigestCache::recordLink(uint64_t inputs, uint64_t outputs) {
+    linkInputs = inputs;
+    linkOutputs = outputs;
+    dirty = true;
+}
+
+uint64_t DigestCache::analysis(const std::string& src) const {
+    auto it = analyses.find(src);
+    return it == analyses.end() ? 0 : it->second;
+}
+
+void DigestCache::recordAnalysis(const std::string& src, uint64_t key) {
+    analyses[src] = key;
+    dirty = true;
+}
+
+// Multiply and rotate per 8 byte word, then a final avalanche
+uint64_t DigestCache::hash(const void* data, size_t size, uint64_t seed) {
+    const uint64_t k1 = 0x9E3779B185EBCA87ull;
+    const uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed ^ (size * k1);
+    while (size >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h ^= w * k2;
+        h = ((h << 31) | (h >> 33)) * k1;
+        p += 8;
+        size -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, size);
+    h ^= tail * k2;
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 29;
+    h *= k1;
+    h ^= h >> 32;
+    return h;
+}
+
+bool DigestCache::hashFile(const fs::path& file, uint64_t& digest) {
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) {
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    digest = 0;
+    while (ifs) {
+        ifs.read(buffer.data(), buffer.size());
+        std::streamsize n = ifs.gcount();
+        if (n <= 0) {
+            break;
+        }
+        digest = hash(buffer.data(), (size_t)n, digest);
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Content digests of build outputs of one objDir, a file is read again only when its
+// mtime or size changed. The link is skipped while objects, libraries and command
+// hash to the recorded value, so a rebuild that reproduces the same bytes stops there.
+class DigestCache {
+public:
+    /**
+     * Read the digests saved by the last build
+     */
+    void load(const fs::path& file);
+
+    /**
+     * Save if anything changed
+     */
+    void save();
+
+    /**
+     * Digest of a file's content, 0 if it can't be read
+     */
+    uint64_t digest(const fs::path& file);
+
+    /**
+     * True if the link inputs and the outputs are the same as at the last recorded link
+     */
+    bool linkUpToDate(uint64_t inputs, uint64_t outputs) const;
+
+    /**
+     * Remember a successful link
+     */
+    void recordLink(uint64_t inputs, uint64_t outputs);
+
+    /**
+     * Key of the last clean analysis of a source, 0 if none
+     */
+    uint64_t analysis(const std::string& src) const;
+
+    /**
+     * Remember a clean analysis of a source
+     */
+    void recordAnalysis(const std::string& src, uint64_t key);
+
+    /**
+     * Hash of bytes, chained through seed
+     */
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+
+private:
+    struct Entry {
+        int64_t mtime = -1;
+        uint64_t size = 0;
+        uint64_t digest = 0;
+    };
+
+    fs::path cacheFile;
+    std::map<std::string, Entry> entries;
+    std::map<std::string, uint64_t> analyses;
+    uint64_t linkInputs = 0;
+    uint64_t linkOutputs = 0;
+    bool dirty = false;
+
+    // Read and hash a whole file, thread safe
+    static bool hashFile(const fs::path& file, uint64_t& digest);
+};
@@ -0,0 +1,172 @@
+#include "DirCache.h"
+#include "Utils.h"
+#include "Stats.h"
+#include "CacheFile.h"
+#include <algorithm>
+
+// Bump when the layout of the cache file changes
+static const uint32_t cacheVersion = 1;
+
+std::map<std::string, DirCache::Listing> DirCache::listings;
+fs::path DirCache::cacheFile;
+bool DirCache::dirty = false;
+
+// Same directory gives the same key, with or without trailing '/'
+static std::string dirKey(const fs::path& dir) {
+    std::string key = dir.lexically_normal().generic_string();
+    while (key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+    return key;
+}
+
+void DirCache::load(const fs::path& file) {
+    if (file == cacheFile) {
+        return;
+    }
+    save();
+    cacheFile = file;
+    listings.clear();
+
+    CacheReader r;
+    if (!r.load(file)) {
+        return;
+    }
+    try {
+        if (r.u64() != cacheVersion) {
+            return;
+        }
+        uint64_t count = r.count();
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string key = r.str();
+            Listing& listing = listings[key];
+            listing.mtime = (int64_t)r.u64();
+            listing.entries.resize(r.count());
+            for (auto& entry : listing.entries) {
+                entry.name = r.str();
+                entry.type = (EntryType)r.u64();
+            }
+        }
+    } catch (const std::exception&) {
+        // Corrupt file, start over
+        listings.clear();
+    }
+}
+
+void DirCache::save() {
+    if (!dirty || cacheFile.empty()) {
+        return;
+    }
+    CacheWriter w;
+    w.u64(cacheVersion);
+    w.u64(listings.size());
+    for (const auto& [key, listing] : listings) {
+        w.str(key);
+        w.u64((uint64_t)listing.mtime);
+        w.u64(listing.entries.size());
+        for (const auto& entry : listing.entries) {
+            w.str(entry.name);
+            w.u64(entry.type);
+        }
+    }
+    w.save(cacheFile);
+    dirty = false;
+}
+
+DirCache::Scan DirCache::scan(const fs::path& dir, const Listing* cached) {
+    Scan result{-1, true, {}, 1};
+    std::error_code ec;
+    auto time = fs::last_write_time(dir, ec);
+    if (ec) {
+        return result;
+    }
+    result.mtime = (int64_t)time.time_since_epoch().count();
+    if (cached && cached->mtime == result.mtime) {
+        result.read = false;
+        return result;
+    }
+
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        result.stats++;
+        std::error_code typeEc;
+        EntryType type = other;
+        if (it->is_symlink(typeEc)) {
+            if (it->is_directory(typeEc)) {
+                type = linkDir;
+            } else if (it->is_regular_file(typeEc)) {
+                type = file;
+            }
+        } else if (it->is_directory(typeEc)) {
+            type = DirCache::dir;
+        } else if (it->is_regular_file(typeEc)) {
+            type = file;
+        }
+        result.entries.push_back(Entry{it->path().filename().string(), type});
+    }
+
+    // Listing order of the file system is not stable
+    std::sort(result.entries.begin(), result.entries.end(), [](const Entry& a, const Entry& b) {
+        return a.name < b.name;
+    });
+    return result;
+}
+
+const DirCache::Listing& DirCache::apply(const std::string& key, Scan& scan) {
+    Stats::count(Stats::fileStat, scan.stats);
+    Listing& listing = listings[key];
+    if (scan.read) {
+        listing.mtime = scan.mtime;
+        listing.entries = std::move(scan.entries);
+        dirty = true;
+    }
+    return listing;
+}
+
+const std::vector<DirCache::Entry>& DirCache::list(const fs::path& dir) {
+    std::string key = dirKey(dir);
+    auto it = listings.find(key);
+    Scan result = scan(dir, it == listings.end() ? nullptr : &it->second);
+    return apply(key, result).entries;
+}
+
+std::vector<fs::path> DirCache::walk(const fs::path& dir, const std::function<bool(const fs::path&)>& enter) {
+    std::vector<fs::path> dirs;
+    std::vector<fs::path> level = {dir};
+
+    // Breadth first, all directories of a level are scanned together
+    while (!level.empty()) {
+        std::vector<std::string> keys(level.size());
+        std::vector<const Listing*> cached(level.size(), nullptr);
+        for (size_t i = 0; i < level.size(); ++i) {
+            keys[i] = dirKey(level[i]);
+            auto it = listings.find(keys[i]);
+            if (it != listings.end()) {
+                cached[i] = &it->second;
+            }
+        }
+
+        std::vector<Scan> scans(level.size());
+        Utils::parallelFor(level.size(), [&](size_t i) {
+            scans[i] = scan(level[i], cached[i]);
+        });
+
+        std::vector<fs::path> nextLevel;
+        for (size_t i = 0; i < level.size(); ++i) {
+            const Listing& listing = apply(keys[i], scans[i]);
+            if (listing.mtime == -1) {
+                continue;
+            }
+            dirs.push_back(level[i]);
+            for (const auto& entry : listing.entries) {
+                if (entry.type == DirCache::dir) {
+                    fs::path sub = level[i] / entry.name;
+                    if (!enter || enter(sub)) {
+                        nextLevel.push_back(sub);
+                    }
+                }
+            }
+        }
+        level.swap(nextLevel);
+    }
+    return dirs;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <cstdint>
+#include <functional>
+
+namespace fs = std::filesystem;
+
+// Directory listings of source trees, reused while the directory mtime is unchanged
+class DirCache {
+public:
+    enum EntryType {
+        other,
+        file,       // regular file, or link to one
+        dir,        // directory
+        linkDir     // link to a directory, not walked into
+    };
+
+    struct Entry {
+        std::string name;
+        EntryType type;
+    };
+
+    /**
+     * Load listings saved by a previous run, once per file
+     */
+    static void load(const fs::path& file);
+
+    /**
+     * Save listings if any directory was read
+     */
+    static void save();
+
+    /**
+     * Entries of a directory
+     */
+    static const std::vector<Entry>& list(const fs::path& dir);
+
+    /**
+     * Directory and all its subdirectories, cold directories are read in parallel.
+     * Subdirectories rejected by enter are skipped with everything below them.
+     */
+    static std::vector<fs::path> walk(const fs::path& dir, const std::function<bool(const fs::path&)>& enter = nullptr);
+
+private:
+    struct Listing {
+        int64_t mtime = -1;
+        std::vector<Entry> entries;
+    };
+
+    // Result of refreshing one directory
+    struct Scan {
+        int64_t mtime;
+        bool read;
+        std::vector<Entry> entries;
+        uint64_t stats;
+    };
+
+    static std::map<std::string, Listing> listings;
+    static fs::path cacheFile;
+    static bool dirty;
+
+    // Stat the directory and read it if changed, safe to run on worker threads
+    static Scan scan(const fs::path& dir, const Listing* cached);
+
+    // Store a scan result, main thread only
+    static const Listing& apply(const std::string& key, Scan& scan);
+};
@@ -3,7 +3,13 @@
 #include <sstream>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include "Utils.h"
+#include "Stats.h"
+#include "CompileCpp.h"
 
 Generator::Generator(const BuildCpp& buildInfo) : buildInfo(buildInfo) {
     outDir = buildInfo.scriptDir / "../build/";
@@ -16,14 +22,32 @@ Generator::Generator(const BuildCpp& buildInfo) : buildInfo(buildInfo) {
 }
 
 void Generator::run(bool clean) {
+    runAll({this}, clean);
+}
+
+void Generator::runAll(const std::vector<Generator*>& generators, bool clean) {
+    std::vector<fs::path> cmakeDirs;
+    {
+        Stats::Phase phase("generate");
+        for (Generator* generator : generators) {
+            fs::path cmakeDir = generator->write(clean);
+            if (!cmakeDir.empty()) {
+                cmakeDirs.push_back(cmakeDir);
+            }
+        }
+    }
+    configure(cmakeDirs);
+}
+
+fs::path Generator::write(bool clean) {
     // Generate QMake file
     isQmake = true;
     fs::path qmakeFile = outDir / (buildInfo.name + "-" + buildInfo.debug + ".pro");
-    std::ofstream qout(qmakeFile);
+    std::ostringstream qout;
     relativePathBase = outDir;
     genQmake(qout);
-    qout.close();
-    std::cout << "Generate QMake file: " << qmakeFile.generic_string() << std::endl;
+    bool changed = Utils::writeIfChanged(qmakeFile, qout.str());
+    std::cout << "Generate QMake file: " << qmakeFile.generic_string() << (changed ? "" : ", unchanged") << std::endl;
 
     // Generate CMake file
     isQmake = false;
@@ -35,40 +59,95 @@ void Generator::run(bool clean) {
     }
     fs::create_directories(cmakeDir);
     fs::path cmakeFile = cmakeDir / "CMakeLists.txt";
-    std::ofstream out(cmakeFile);
+    std::ostringstream out;
     relativePathBase = cmakeDir;
     genCmake(out);
-    out.close();
-    std::cout << "Generate CMake file: " << cmakeDir.generic_string() << std::endl;
+    changed = Utils::writeIfChanged(cmakeFile, out.str());
+    std::cout << "Generate CMake file: " << cmakeDir.generic_string() << (changed ? "" : ", unchanged") << std::endl;
 
-    // Execute CMake
-    exe(cmakeDir);
+    // A configured project reruns cmake itself when its inputs change
+    Stats::count(Stats::fileStat);
+    if (!changed && fs::exists(cmakeDir / "CMakeCache.txt")) {
+        return fs::path();
+    }
+    return cmakeDir;
 }
 
-void Generator::exe(const fs::path& cmakeDir) {
-    std::vector<std::string> cmds = {"cmake", "."};
+void Generator::runNinja(bool clean, const fs::path& scriptFile, const std::string& target) {
+    Stats::Phase phase("generate");
+    fs::path ninjaDir = outDir / ("ninja-" + buildInfo.name + "-" + buildInfo.compiler + "-" + buildInfo.debug);
+    if (clean && fs::exists(ninjaDir)) {
+        fs::remove_all(ninjaDir);
+    }
+    fs::create_directories(ninjaDir);
+    ninjaDir = fs::canonical(ninjaDir);
+
+    std::string regenCmd = Utils::exePath() + " -no-daemon -G ninja -c " + buildInfo.compiler;
+    if (buildInfo.debug == "debug") {
+        regenCmd += " -d";
+    }
+    // Options that change the commands, -configs writes one file per compiler:mode named by -c and -d
+    if (buildInfo.devLink) {
+        regenCmd += " -devlink";
+    }
+    if (buildInfo.timeTrace) {
+        regenCmd += " -time-trace";
+    }
+    if (buildInfo.pgo) {
+        regenCmd += " -pgo";
+    }
+    if (buildInfo.layout) {
+        regenCmd += " -layout";
+    }
+    if (!target.empty()) {
+        regenCmd += " -t " + target;
+    }
+    regenCmd += " " + scriptFile.generic_string();
+
+    CompileCpp cc(buildInfo);
+    bool changed = cc.genNinja(ninjaDir, regenCmd);
+    std::cout << "Generate Ninja file: " << (ninjaDir / "build.ninja").generic_string() << (changed ? "" : ", unchanged") << std::endl;
+}
+
+void Generator::configure(const std::vector<fs::path>& cmakeDirs) {
+    if (cmakeDirs.empty()) {
+        return;
+    }
+    Stats::Phase phase("configure");
+    Stats::count(Stats::process, cmakeDirs.size());
+
+    // Output goes to cmake.log, parallel runs would mix it
+    std::vector<std::string> cmds;
+    for (const auto& cmakeDir : cmakeDirs) {
+        std::string dir = cmakeDir.generic_string();
+        std::string cd = (strcmp(Utils::osName(), "win32") == 0) ? "cd /d \"" : "cd \"";
+        cmds.push_back(cd + dir + "\" && cmake . > cmake.log 2>&1");
+        std::cout << "Exec cmake . in " << dir << std::endl;
+    }
 
-    try {
-        std::string cmdStr;
-        for (const auto& cmd : cmds) {
-            cmdStr += cmd + " ";
+    std::vector<int> results(cmds.size());
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < cmds.size(); i = next++) {
+            results[i] = std::system(cmds[i].c_str());
         }
-        std::cout << "Exec " << cmdStr << " in " << cmakeDir.generic_string() << std::endl;
-
-        // Save current directory
-        fs::path oldPath = fs::current_path();
-        // Change to cmakeDir
-        fs::current_path(cmakeDir);
-        
-        int result = std::system(cmdStr.c_str());
-        if (result != 0) {
-            std::cerr << "Exec failed [" << cmdStr << "]" << std::endl;
+    };
+    size_t count = std::min<size_t>(cmds.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        if (results[i] != 0) {
+            std::cerr << "Exec failed [cmake .] in " << cmakeDirs[i].generic_string() << std::endl;
+            std::ifstream log(cmakeDirs[i] / "cmake.log");
+            std::cerr << log.rdbuf();
         }
-        
-        // Restore old directory
-        fs::current_path(oldPath);
-    } catch (...) {
-        std::cerr << "Exec failed [cmake .]" << std::endl;
     }
 }
 
@@ -108,7 +187,7 @@ std::string Generator::toPath(const fs::path& uri, bool keepPath, const std::str
     return path;
 }
 
-void Generator::genQmake(std::ofstream& out) {
+void Generator::genQmake(std::ostream& out) {
     out << "#QT -= core gui" << std::endl;
 
     std::string targetName = buildInfo.name;
@@ -255,7 +334,7 @@ void Generator::genQmake(std::ofstream& out) {
     }
 }
 
-void Generator::genCmake(std::ofstream& out) {
+void Generator::genCmake(std::ostream& out) {
     out << "cmake_minimum_required (VERSION 3.10)" << std::endl;
     out << "project (" << buildInfo.name << "_ws)" << std::endl;
     out << std::endl;
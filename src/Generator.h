@@ -23,18 +23,27 @@ public:
     // Run generator
     void run(bool clean);
 
+    // Generate the files of every target, then configure the changed cmake projects in parallel
+    static void runAll(const std::vector<Generator*>& generators, bool clean);
+
+    // Generate build.ninja with the tool chain commands, target and scriptFile rerun fmake on change
+    void runNinja(bool clean, const fs::path& scriptFile, const std::string& target);
+
 private:
-    // Execute command
-    void exe(const fs::path& cmakeDir);
+    // Write QMake and CMake files, returns the cmake directory if it needs a configure
+    fs::path write(bool clean);
+
+    // Run cmake in each directory
+    static void configure(const std::vector<fs::path>& cmakeDirs);
 
     // Convert path to string
     std::string toPath(const fs::path& uri, bool keepPath = false, const std::string* filter = nullptr) const;
 
     // Generate QMake file
-    void genQmake(std::ofstream& out);
+    void genQmake(std::ostream& out);
 
     // Generate CMake file
-    void genCmake(std::ofstream& out);
+    void genCmake(std::ostream& out);
 
     // Copy header files
     void copyHeaderFile(const std::function<void(const fs::path&, const fs::path&)>& cb);
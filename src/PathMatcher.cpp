@@ -0,0 +1,257 @@
+#include "PathMatcher.h"
+#include "Utils.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstring>
+
+static const char* regexPrefix = "regex:";
+
+void PathMatcher::add(const std::string& patterns) {
+    for (const std::string& pattern : Utils::split(patterns, ',')) {
+        if (pattern.empty()) {
+            continue;
+        }
+        if (pattern.compare(0, strlen(regexPrefix), regexPrefix) == 0) {
+            regexes.emplace_back(pattern.substr(strlen(regexPrefix)));
+        } else {
+            addGlob(pattern);
+        }
+    }
+}
+
+bool PathMatcher::empty() const {
+    return nfa.empty() && regexes.empty();
+}
+
+int PathMatcher::newNode() {
+    nfa.emplace_back();
+    return (int)nfa.size() - 1;
+}
+
+void PathMatcher::addGlob(const std::string& pattern) {
+    if (nfa.empty()) {
+        newNode();
+    }
+    // DFA states refer to the old NFA
+    dfa.clear();
+    stateIds.clear();
+
+    std::string glob = pattern;
+    while (glob.compare(0, 2, "./") == 0) {
+        glob = glob.substr(2);
+    }
+    if (!glob.empty() && glob[0] == '/') {
+        glob = glob.substr(1);
+    }
+
+    std::bitset<256> all;
+    all.set();
+    std::bitset<256> notSlash = all;
+    notSlash.reset('/');
+    std::bitset<256> slash;
+    slash.set('/');
+
+    int cur = newNode();
+    nfa[0].epsilon.push_back(cur);
+
+    // Optional directories: (.*/)?
+    auto dirStar = [&]() {
+        int mid = newNode();
+        int next = newNode();
+        nfa[cur].epsilon.push_back(next);
+        nfa[cur].edges.push_back({all, mid});
+        nfa[cur].edges.push_back({slash, next});
+        nfa[mid].edges.push_back({all, mid});
+        nfa[mid].edges.push_back({slash, next});
+        cur = next;
+    };
+
+    if (glob.find('/') == std::string::npos) {
+        dirStar();
+    }
+
+    size_t i = 0;
+    while (i < glob.size()) {
+        char c = glob[i];
+        if (c == '*' && i + 1 < glob.size() && glob[i + 1] == '*') {
+            bool atStart = (i == 0 || glob[i - 1] == '/');
+            if (atStart && i + 2 < glob.size() && glob[i + 2] == '/') {
+                dirStar();
+                i += 3;
+            } else {
+                nfa[cur].edges.push_back({all, cur});
+                i += 2;
+            }
+            continue;
+        }
+
+        std::bitset<256> set;
+        if (c == '*') {
+            int next = newNode();
+            nfa[cur].edges.push_back({notSlash, cur});
+            nfa[cur].epsilon.push_back(next);
+            cur = next;
+            ++i;
+            continue;
+        } else if (c == '?') {
+            set = notSlash;
+            ++i;
+        } else if (c == '[' && glob.find(']', i + 2) != std::string::npos) {
+            size_t end = glob.find(']', i + 2);
+            size_t j = i + 1;
+            bool negate = (glob[j] == '!' || glob[j] == '^');
+            if (negate) {
+                ++j;
+            }
+            for (; j < end; ++j) {
+                unsigned char from = glob[j];
+                if (j + 2 < end && glob[j + 1] == '-') {
+                    unsigned char to = glob[j + 2];
+                    for (int k = from; k <= to; ++k) {
+                        set.set(k);
+                    }
+                    j += 2;
+                } else {
+                    set.set(from);
+                }
+            }
+            if (negate) {
+                set.flip();
+            }
+            set.reset('/');
+            i = end + 1;
+        } else {
+            if (c == '\\' && i + 1 < glob.size()) {
+                ++i;
+            }
+            set.set((unsigned char)glob[i]);
+            ++i;
+        }
+        int next = newNode();
+        nfa[cur].edges.push_back({set, next});
+        cur = next;
+    }
+    nfa[cur].accept = true;
+}
+
+int PathMatcher::stateOf(std::vector<int> nodes) {
+    // Epsilon closure
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (int e : nfa[nodes[i]].epsilon) {
+            if (std::find(nodes.begin(), nodes.end(), e) == nodes.end()) {
+                nodes.push_back(e);
+            }
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+
+    auto it = stateIds.find(nodes);
+    if (it != stateIds.end()) {
+        return it->second;
+    }
+    State state;
+    state.next.fill(-1);
+    for (int n : nodes) {
+        if (nfa[n].accept) {
+            state.accept = true;
+        }
+    }
+    state.nodes = nodes;
+    dfa.push_back(state);
+    int id = (int)dfa.size() - 1;
+    stateIds[nodes] = id;
+    return id;
+}
+
+int PathMatcher::step(int state, unsigned char c) {
+    int next = dfa[state].next[c];
+    if (next >= 0) {
+        return next;
+    }
+    std::vector<int> nodes;
+    for (int n : dfa[state].nodes) {
+        for (const auto& [set, to] : nfa[n].edges) {
+            if (set.test(c) && std::find(nodes.begin(), nodes.end(), to) == nodes.end()) {
+                nodes.push_back(to);
+            }
+        }
+    }
+    next = stateOf(nodes);
+    dfa[state].next[c] = next;
+    return next;
+}
+
+int PathMatcher::run(const std::string& path) {
+    if (dfa.empty()) {
+        stateOf({0});
+    }
+    int state = 0;
+    for (char c : path) {
+        state = step(state, (unsigned char)c);
+    }
+    return state;
+}
+
+void PathMatcher::classify(int state) {
+    if (dfa[state].canAccept >= 0) {
+        return;
+    }
+    // Explore every state reachable from this one
+    std::vector<int> reach = {state};
+    std::vector<bool> seen(dfa.size(), false);
+    seen[state] = true;
+    bool can = false;
+    bool always = true;
+    for (size_t i = 0; i < reach.size(); ++i) {
+        int s = reach[i];
+        can = can || dfa[s].accept;
+        always = always && dfa[s].accept;
+        for (int c = 0; c < 256; ++c) {
+            int next = step(s, (unsigned char)c);
+            if ((size_t)next >= seen.size()) {
+                seen.resize(dfa.size(), false);
+            }
+            if (!seen[next]) {
+                seen[next] = true;
+                reach.push_back(next);
+            }
+        }
+    }
+    dfa[state].canAccept = can ? 1 : 0;
+    dfa[state].alwaysAccept = always ? 1 : 0;
+}
+
+bool PathMatcher::match(const std::string& path) {
+    if (!nfa.empty() && dfa[run(path)].accept) {
+        return true;
+    }
+    for (const auto& regex : regexes) {
+        Stats::count(Stats::regexMatch);
+        if (std::regex_match(path, regex)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathMatcher::noneBelow(const std::string& dir) {
+    // Nothing is known about regexes
+    if (!regexes.empty()) {
+        return false;
+    }
+    if (nfa.empty()) {
+        return true;
+    }
+    int state = run(dir);
+    classify(state);
+    return dfa[state].canAccept == 0;
+}
+
+bool PathMatcher::allBelow(const std::string& dir) {
+    if (nfa.empty()) {
+        return false;
+    }
+    int state = run(dir);
+    classify(state);
+    return dfa[state].alwaysAccept == 1;
+}
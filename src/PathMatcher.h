@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <bitset>
+#include <regex>
+
+// Matches relative paths against a set of patterns.
+// Globs: '*' and '?' stop at '/', '**' crosses directories, [a-z] and [!a-z] classes, '\' escapes.
+// A glob without '/' matches the file name in any directory.
+// Patterns starting with "regex:" are std::regex matched against the whole path.
+// All globs are compiled into one lazily built DFA.
+class PathMatcher {
+public:
+    /**
+     * Add comma separated patterns
+     */
+    void add(const std::string& patterns);
+
+    bool empty() const;
+
+    /**
+     * Whole path matches any pattern
+     */
+    bool match(const std::string& path);
+
+    /**
+     * No path below the directory can match, dir ends with '/'
+     */
+    bool noneBelow(const std::string& dir);
+
+    /**
+     * Every path below the directory matches, dir ends with '/'
+     */
+    bool allBelow(const std::string& dir);
+
+private:
+    // NFA built from the globs, node 0 is the start
+    struct Node {
+        bool accept = false;
+        std::vector<int> epsilon;
+        std::vector<std::pair<std::bitset<256>, int>> edges;
+    };
+
+    // Lazily built DFA state, a set of NFA nodes
+    struct State {
+        std::vector<int> nodes;
+        bool accept = false;
+        std::array<int, 256> next;
+        // Reachability of accepting states, -1 until computed
+        int canAccept = -1;
+        int alwaysAccept = -1;
+    };
+
+    std::vector<Node> nfa;
+    std::vector<State> dfa;
+    std::map<std::vector<int>, int> stateIds;
+    std::vector<std::regex> regexes;
+
+    void addGlob(const std::string& glob);
+    int newNode();
+    int stateOf(std::vector<int> nodes);
+    int step(int state, unsigned char c);
+    int run(const std::string& path);
+    void classify(int state);
+};
@@ -0,0 +1,199 @@
+#include "RepoIndex.h"
+#include "Utils.h"
+#include "Stats.h"
+#include <fstream>
+#include <thread>
+#include <chrono>
+
+static const char* indexName = "index.props";
+
+// Join with ',' as in meta.props
+static std::string join(const std::vector<std::string>& list) {
+    std::string str;
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (i > 0) {
+            str += ",";
+        }
+        str += list[i];
+    }
+    return str;
+}
+
+static std::vector<std::string> splitList(const std::string& str) {
+    std::vector<std::string> list;
+    for (const auto& token : Utils::split(str, ',')) {
+        if (!token.empty()) {
+            list.push_back(token);
+        }
+    }
+    return list;
+}
+
+std::map<std::string, RepoEntry> RepoIndex::read(const fs::path& file) {
+    std::map<std::string, RepoEntry> result;
+    auto props = Utils::readProps(file);
+    for (const auto& [k, v] : props) {
+        size_t pos = k.rfind('.');
+        if (pos == std::string::npos) {
+            continue;
+        }
+        RepoEntry& entry = result[k.substr(0, pos)];
+        std::string field = k.substr(pos + 1);
+        if (field == "version") {
+            entry.version = v;
+        } else if (field == "depends") {
+            entry.depends = v;
+        } else if (field == "includes") {
+            entry.includes = splitList(v);
+        } else if (field == "includesRewrite") {
+            entry.includesRewrite = (v == "true");
+        } else if (field == "libs") {
+            entry.libs = splitList(v);
+        }
+    }
+    return result;
+}
+
+void RepoIndex::write(const fs::path& file, const std::map<std::string, RepoEntry>& entries) {
+    fs::path tmpFile = file.generic_string() + ".tmp";
+    std::ofstream ofs(tmpFile);
+    for (const auto& [name, entry] : entries) {
+        ofs << name << ".version=" << entry.version << std::endl;
+        ofs << name << ".depends=" << entry.depends << std::endl;
+        ofs << name << ".includes=" << join(entry.includes) << std::endl;
+        ofs << name << ".includesRewrite=" << (entry.includesRewrite ? "true" : "false") << std::endl;
+        ofs << name << ".libs=" << join(entry.libs) << std::endl;
+    }
+    ofs.close();
+    // Readers never see a partial index
+    fs::rename(tmpFile, file);
+}
+
+void RepoIndex::load(const fs::path& outHome) {
+    home = outHome;
+    file = outHome / indexName;
+    entries = read(file);
+    installed.clear();
+}
+
+const RepoEntry* RepoIndex::find(const std::string& pod) const {
+    auto it = entries.find(pod);
+    if (it == entries.end()) {
+        return nullptr;
+    }
+
+    // A pod deleted behind fmake's back is a miss, meta.props or the missing depend error decide
+    auto check = installed.find(pod);
+    if (check == installed.end()) {
+        bool ok = fs::is_directory(home / pod / "lib/");
+        Stats::count(Stats::fileStat);
+        if (it->second.includesRewrite) {
+            for (const auto& dir : it->second.includes) {
+                ok = ok && fs::exists(dir);
+                Stats::count(Stats::fileStat);
+            }
+        } else {
+            ok = ok && fs::is_directory(home / pod / "include/");
+            Stats::count(Stats::fileStat);
+        }
+        check = installed.emplace(pod, ok).first;
+    }
+    return check->second ? &it->second : nullptr;
+}
+
+void RepoIndex::locked(const fs::path& outHome, const std::function<void()>& fn) {
+    // Creating a directory is atomic on every platform, use it as the lock
+    fs::path lock = outHome / (std::string(indexName) + ".lock");
+    auto start = std::chrono::steady_clock::now();
+    while (!fs::create_directory(lock)) {
+        // Left by a killed process
+        if (std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) {
+            fs::remove(lock);
+            start = std::chrono::steady_clock::now();
+            continue;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    try {
+        fn();
+    } catch (...) {
+        fs::remove(lock);
+        throw;
+    }
+    fs::remove(lock);
+}
+
+void RepoIndex::update(const fs::path& outHome, const std::map<std::string, std::string>& meta, const fs::path& libDir) {
+    auto get = [&](const char* key) {
+        auto it = meta.find(key);
+        return it == meta.end() ? std::string() : it->second;
+    };
+
+    RepoEntry entry;
+    entry.version = get("pod.version");
+    entry.depends = get("pod.depends");
+    entry.includes = splitList(get("pod.includes"));
+    entry.includesRewrite = (get("pod.includesRewrite") == "true");
+    entry.libs = libNames(libDir);
+
+    locked(outHome, [&]() {
+        fs::path file = outHome / indexName;
+        auto entries = read(file);
+        // Unchanged pods keep the index untouched, readers cache on its mtime
+        auto it = entries.find(get("pod.name"));
+        if (it == entries.end() || !(it->second == entry)) {
+            entries[get("pod.name")] = entry;
+            write(file, entries);
+        }
+    });
+}
+
+void RepoIndex::remove(const fs::path& outHome, const std::string& pod) {
+    fs::path file = outHome / indexName;
+    if (!fs::exists(file)) {
+        return;
+    }
+    locked(outHome, [&]() {
+        auto entries = read(file);
+        if (entries.erase(pod) > 0) {
+            write(file, entries);
+        }
+    });
+}
+
+std::vector<std::string> RepoIndex::libNames(const fs::path& libDir) {
+    std::vector<std::string> libs;
+    if (!fs::is_directory(libDir)) {
+        return libs;
+    }
+
+    for (const auto& entry : fs::directory_iterator(libDir)) {
+        Stats::count(Stats::fileStat);
+        if (fs::is_regular_file(entry)) {
+            std::string ext = entry.path().extension().generic_string();
+            if (ext == ".a" || ext == ".so") {
+                std::string libName = entry.path().filename().generic_string();
+                if (libName.substr(0, 3) == "lib" && libName.substr(libName.size() - 2) == ".a") {
+                    libs.push_back(libName.substr(3, libName.size() - 5));
+                } else if (libName.substr(0, 3) == "lib" && libName.substr(libName.size() - 3) == ".so") {
+                    libs.push_back(libName.substr(3, libName.size() - 6));
+                } else {
+                    libs.push_back(libName);
+                }
+            }
+        }
+    }
+
+    if (libs.empty()) {
+        for (const auto& entry : fs::directory_iterator(libDir)) {
+            if (fs::is_regular_file(entry)) {
+                std::string ext = entry.path().extension().generic_string();
+                if (ext == ".lib") {
+                    libs.push_back(entry.path().filename().generic_string());
+                }
+            }
+        }
+    }
+    return libs;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Installed pod as recorded in the repo index
+struct RepoEntry {
+    std::string version;
+    std::string depends;
+    std::vector<std::string> includes;
+    bool includesRewrite = false;
+    std::vector<std::string> libs;
+
+    bool operator==(const RepoEntry& other) const {
+        return version == other.version && depends == other.depends && includes == other.includes
+            && includesRewrite == other.includesRewrite && libs == other.libs;
+    }
+};
+
+// Index of all pods in fmakeRepo/<compiler>/<mode>/, one file read resolves every depend
+class RepoIndex {
+public:
+    // Index file, empty until loaded
+    fs::path file;
+
+    /**
+     * Read the index of a repo directory
+     */
+    void load(const fs::path& outHome);
+
+    /**
+     * Entry of a pod, null if not indexed or its directories are gone
+     */
+    const RepoEntry* find(const std::string& pod) const;
+
+    /**
+     * Record an installed pod from its meta data, atomic against concurrent installs
+     */
+    static void update(const fs::path& outHome, const std::map<std::string, std::string>& meta, const fs::path& libDir);
+
+    /**
+     * Drop the entry of a removed pod, atomic against concurrent installs
+     */
+    static void remove(const fs::path& outHome, const std::string& pod);
+
+    /**
+     * Library names to link of a pod lib directory
+     */
+    static std::vector<std::string> libNames(const fs::path& libDir);
+
+private:
+    std::map<std::string, RepoEntry> entries;
+
+    // Repo directory of the loaded index
+    fs::path home;
+
+    // Pods whose lib and include directories were checked, stat once per load
+    mutable std::map<std::string, bool> installed;
+
+    // Run fn holding the lock of the index in outHome
+    static void locked(const fs::path& outHome, const std::function<void()>& fn);
+
+    static std::map<std::string, RepoEntry> read(const fs::path& file);
+    static void write(const fs::path& file, const std::map<std::string, RepoEntry>& entries);
+};
@@ -0,0 +1,111 @@
+#include "StatCache.h"
+#include "Utils.h"
+#include "Stats.h"
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+std::unordered_map<std::string, StatCache::Info> StatCache::infos;
+
+std::string StatCache::key(const fs::path& path) {
+    return path.lexically_normal().generic_string();
+}
+
+StatCache::Info StatCache::statPath(const std::string& path) {
+    Info info;
+#ifdef _WIN32
+    std::error_code ec;
+    fs::file_status status = fs::status(path, ec);
+    if (ec || !fs::exists(status)) {
+        return info;
+    }
+    info.exists = true;
+    info.isFile = fs::is_regular_file(status);
+    info.mtime = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+    info.size = info.isFile ? (uint64_t)fs::file_size(path, ec) : 0;
+#else
+    // Type and time with a single syscall
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return info;
+    }
+    info.exists = true;
+    info.isFile = S_ISREG(st.st_mode);
+    info.size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+    info.mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    info.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return info;
+}
+
+void StatCache::prefetch(const std::vector<std::string>& paths) {
+    std::vector<std::string> missing;
+    for (const auto& path : paths) {
+        if (infos.find(path) == infos.end()) {
+            // Reserve the slot so duplicates are stat'ed once
+            infos.emplace(path, Info());
+            missing.push_back(path);
+        }
+    }
+
+    std::vector<Info> results(missing.size());
+    Utils::parallelFor(missing.size(), [&](size_t i) {
+        results[i] = statPath(missing[i]);
+    });
+    for (size_t i = 0; i < missing.size(); ++i) {
+        infos[missing[i]] = results[i];
+    }
+    Stats::count(Stats::fileStat, missing.size());
+}
+
+const StatCache::Info& StatCache::get(const std::string& path) {
+    auto it = infos.find(path);
+    if (it != infos.end()) {
+        return it->second;
+    }
+    Stats::count(Stats::fileStat);
+    return infos.emplace(path, statPath(path)).first->second;
+}
+
+void StatCache::forget(const std::vector<std::string>& paths) {
+    if (paths.empty()) {
+        infos.clear();
+        return;
+    }
+    for (const auto& path : paths) {
+        infos.erase(path);
+    }
+}
+
+void StatCache::forgetUnder(const std::vector<std::string>& paths) {
+    if (paths.empty()) {
+        return;
+    }
+    std::unordered_set<std::string> roots(paths.begin(), paths.end());
+    for (auto it = infos.begin(); it != infos.end();) {
+        // Look up the key and each of its parents
+        const std::string& key = it->first;
+        bool under = false;
+        for (size_t end = key.size(); end != std::string::npos && end > 0; end = key.rfind('/', end - 1)) {
+            if (roots.count(key.substr(0, end))) {
+                under = true;
+                break;
+            }
+        }
+        it = under ? infos.erase(it) : std::next(it);
+    }
+}
+
+std::vector<std::string> StatCache::paths() {
+    std::vector<std::string> keys;
+    keys.reserve(infos.size());
+    for (const auto& [key, info] : infos) {
+        keys.push_back(key);
+    }
+    return keys;
+}
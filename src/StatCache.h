@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Per process cache of file metadata, each path is stat'ed at most once
+class StatCache {
+public:
+    struct Info {
+        bool exists = false;
+        bool isFile = false;
+        // Nanoseconds, only comparable with other StatCache times
+        int64_t mtime = -1;
+        uint64_t size = 0;
+    };
+
+    /**
+     * Cache key of a path, same file gives the same key without touching the disk
+     */
+    static std::string key(const fs::path& path);
+
+    /**
+     * Stat all uncached paths in parallel batches, paths are keys
+     */
+    static void prefetch(const std::vector<std::string>& paths);
+
+    /**
+     * Metadata of a key, stat on miss
+     */
+    static const Info& get(const std::string& path);
+
+    /**
+     * Drop paths that were written, or everything if empty
+     */
+    static void forget(const std::vector<std::string>& paths = {});
+
+    /**
+     * Drop keys equal to or below any of the paths, for directories that were removed or replaced
+     */
+    static void forgetUnder(const std::vector<std::string>& paths);
+
+    /**
+     * Keys of all cached paths
+     */
+    static std::vector<std::string> paths();
+
+private:
+    static std::unordered_map<std::string, Info> infos;
+
+    // One stat syscall, thread safe
+    static Info statPath(const std::string& path);
+};
@@ -0,0 +1,87 @@
+#include "Stats.h"
+#include <iomanip>
+
+bool Stats::enabled = false;
+std::map<std::string, Stats::Entry> Stats::entries;
+std::vector<std::string> Stats::order;
+std::vector<Stats::Frame> Stats::stack;
+
+// Column width of each counter
+static const int widths[Stats::counterCount] = {10, 8, 12, 8, 8, 8, 8, 8};
+
+Stats::Entry& Stats::entry(const std::string& name) {
+    auto it = entries.find(name);
+    if (it == entries.end()) {
+        order.push_back(name);
+        it = entries.emplace(name, Entry()).first;
+    }
+    return it->second;
+}
+
+void Stats::add(Counter c, uint64_t n) {
+    const std::string& name = stack.empty() ? std::string("other") : stack.back().name;
+    entry(name).counters[c] += n;
+}
+
+Stats::Phase::Phase(const char* name) : active(enabled) {
+    if (!active) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    // Pause the outer phase, time is exclusive
+    if (!stack.empty()) {
+        entry(stack.back().name).time += now - stack.back().start;
+    }
+    entry(name).calls++;
+    stack.push_back(Frame{name, now});
+}
+
+Stats::Phase::~Phase() {
+    if (!active) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    entry(stack.back().name).time += now - stack.back().start;
+    stack.pop_back();
+    if (!stack.empty()) {
+        stack.back().start = now;
+    }
+}
+
+void Stats::reset() {
+    enabled = false;
+    entries.clear();
+    order.clear();
+    stack.clear();
+}
+
+void Stats::print(std::ostream& out) {
+    if (!enabled) {
+        return;
+    }
+    out << std::left << std::setw(14) << "phase" << std::right
+        << std::setw(10) << "time(ms)" << std::setw(8) << "calls" << std::setw(10) << "stat"
+        << std::setw(8) << "read" << std::setw(12) << "bytes" << std::setw(8) << "regex" << std::setw(8) << "proc"
+        << std::setw(8) << "clone" << std::setw(8) << "link" << std::setw(8) << "copy" << std::endl;
+
+    Entry total;
+    for (const auto& name : order) {
+        const Entry& e = entries[name];
+        double ms = std::chrono::duration<double, std::milli>(e.time).count();
+        out << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(10) << ms << std::setw(8) << e.calls;
+        for (int i = 0; i < counterCount; ++i) {
+            out << std::setw(widths[i]) << e.counters[i];
+            total.counters[i] += e.counters[i];
+        }
+        out << std::endl;
+        total.time += e.time;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(total.time).count();
+    out << std::left << std::setw(14) << "total" << std::right << std::setw(10) << ms << std::setw(8) << "";
+    for (int i = 0; i < counterCount; ++i) {
+        out << std::setw(widths[i]) << total.counters[i];
+    }
+    out << std::endl << std::defaultfloat;
+}
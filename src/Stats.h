@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+// Self profiling of fmake, enabled by -stats
+class Stats {
+public:
+    enum Counter {
+        fileStat,   // exists, last_write_time, canonical, directory entry
+        fileRead,   // files opened for reading
+        bytesRead,  // bytes read from files
+        regexMatch, // std::regex matches
+        process,    // child processes spawned
+        fileClone,  // files installed as reflinks
+        fileLink,   // files installed as hard links
+        fileCopy,   // files installed by copying bytes
+        counterCount
+    };
+
+    // Collect statistics
+    static bool enabled;
+
+    // Add to the counter of the innermost phase
+    static void count(Counter c, uint64_t n = 1) {
+        if (enabled) {
+            add(c, n);
+        }
+    }
+
+    // Print time and counters of each phase
+    static void print(std::ostream& out);
+
+    // Disable and drop all phases, a daemon starts each command fresh
+    static void reset();
+
+    // Scoped phase, time and counters go to the innermost phase
+    class Phase {
+    public:
+        Phase(const char* name);
+        ~Phase();
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+    private:
+        bool active;
+    };
+
+private:
+    struct Entry {
+        uint64_t calls = 0;
+        std::chrono::steady_clock::duration time{};
+        uint64_t counters[counterCount] = {};
+    };
+
+    struct Frame {
+        std::string name;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    static std::map<std::string, Entry> entries;
+    static std::vector<std::string> order;
+    static std::vector<Frame> stack;
+
+    static void add(Counter c, uint64_t n);
+    static Entry& entry(const std::string& name);
+};
@@ -0,0 +1,230 @@
+#include "TimeTrace.h"
+#include "Utils.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <iomanip>
+
+std::vector<TraceEvent> TimeTrace::read(const fs::path& file) {
+    std::vector<TraceEvent> events;
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) {
+        return events;
+    }
+    std::stringstream buffer;
+    buffer << ifs.rdbuf();
+    std::string str = buffer.str();
+
+    size_t pos = str.find("\"traceEvents\"");
+    if (pos == std::string::npos) {
+        return events;
+    }
+    pos = str.find('[', pos);
+    if (pos == std::string::npos) {
+        return events;
+    }
+    ++pos;
+
+    while (pos < str.size()) {
+        skipSpace(str, pos);
+        if (pos >= str.size() || str[pos] == ']') {
+            break;
+        }
+        if (str[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (str[pos] != '{') {
+            Utils::throwError("Bad trace file: " + file.generic_string());
+        }
+        TraceEvent event;
+        event.dur = 0;
+        parseEvent(str, pos, event);
+        // Only complete events carry a duration
+        if (event.dur > 0) {
+            events.push_back(event);
+        }
+    }
+    return events;
+}
+
+bool TimeTrace::add(const fs::path& file) {
+    if (!fs::exists(file)) {
+        return false;
+    }
+    for (const auto& event : read(file)) {
+        if (event.name.compare(0, 6, "Total ") == 0) {
+            Stat& stat = totals[event.name.substr(6)];
+            stat.count++;
+            stat.dur += event.dur;
+        } else if (!event.detail.empty()) {
+            Stat& stat = stats[event.name][event.detail];
+            stat.count++;
+            stat.dur += event.dur;
+        }
+    }
+    files++;
+    return true;
+}
+
+void TimeTrace::report(std::ostream& out, size_t top) const {
+    out << "Time trace of " << files << " files" << std::endl;
+    out << std::endl << "**** Phases:" << std::endl;
+    std::vector<std::pair<std::string, Stat>> phases(totals.begin(), totals.end());
+    std::sort(phases.begin(), phases.end(), [](const auto& a, const auto& b) {
+        return a.second.dur > b.second.dur;
+    });
+    for (const auto& [name, stat] : phases) {
+        out << std::setw(10) << (long)(stat.dur / 1000) << " ms  " << name << std::endl;
+    }
+
+    // Nested instantiations are also counted in their parents
+    reportKind(out, "Templates that took longest to instantiate", {"InstantiateClass", "InstantiateFunction"}, top);
+    reportKind(out, "Functions that took longest to compile", {"CodeGen Function", "OptFunction"}, top);
+    reportKind(out, "Headers that took longest to parse", {"Source"}, top);
+}
+
+void TimeTrace::reportKind(std::ostream& out, const std::string& title, const std::vector<std::string>& names, size_t top) const {
+    std::map<std::string, Stat> merged;
+    for (const auto& name : names) {
+        auto it = stats.find(name);
+        if (it == stats.end()) {
+            continue;
+        }
+        for (const auto& [detail, stat] : it->second) {
+            Stat& m = merged[detail];
+            m.count += stat.count;
+            m.dur += stat.dur;
+        }
+    }
+
+    std::vector<std::pair<std::string, Stat>> items(merged.begin(), merged.end());
+    std::sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+        return a.second.dur > b.second.dur;
+    });
+
+    out << std::endl << "**** " << title << ":" << std::endl;
+    for (size_t i = 0; i < items.size() && i < top; ++i) {
+        const Stat& stat = items[i].second;
+        out << std::setw(10) << (long)(stat.dur / 1000) << " ms  " << std::setw(6) << stat.count << " times, avg "
+            << (long)(stat.dur / stat.count / 1000) << " ms  " << items[i].first << std::endl;
+    }
+}
+
+void TimeTrace::skipSpace(const std::string& str, size_t& pos) {
+    while (pos < str.size() && (str[pos] == ' ' || str[pos] == '\t' || str[pos] == '\r' || str[pos] == '\n')) {
+        ++pos;
+    }
+}
+
+std::string TimeTrace::parseString(const std::string& str, size_t& pos) {
+    std::string result;
+    // Skip opening quote
+    ++pos;
+    while (pos < str.size() && str[pos] != '"') {
+        char c = str[pos++];
+        if (c == '\\' && pos < str.size()) {
+            char e = str[pos++];
+            switch (e) {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case 'u':
+                    // Keep non-ASCII escapes as is
+                    result += "\\u";
+                    break;
+                default: result += e; break;
+            }
+        } else {
+            result += c;
+        }
+    }
+    // Skip closing quote
+    ++pos;
+    return result;
+}
+
+double TimeTrace::parseNumber(const std::string& str, size_t& pos) {
+    const char* begin = str.c_str() + pos;
+    char* end = nullptr;
+    double value = std::strtod(begin, &end);
+    pos += end - begin;
+    return value;
+}
+
+void TimeTrace::skipValue(const std::string& str, size_t& pos) {
+    skipSpace(str, pos);
+    if (pos >= str.size()) {
+        return;
+    }
+    char c = str[pos];
+    if (c == '"') {
+        parseString(str, pos);
+    } else if (c == '{' || c == '[') {
+        // Skip nested object or array, strings may contain brackets
+        int level = 0;
+        while (pos < str.size()) {
+            c = str[pos];
+            if (c == '"') {
+                parseString(str, pos);
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++level;
+            } else if (c == '}' || c == ']') {
+                --level;
+                if (level == 0) {
+                    ++pos;
+                    return;
+                }
+            }
+            ++pos;
+        }
+    } else {
+        // Number or literal
+        while (pos < str.size() && str[pos] != ',' && str[pos] != '}' && str[pos] != ']') {
+            ++pos;
+        }
+    }
+}
+
+void TimeTrace::parseEvent(const std::string& str, size_t& pos, TraceEvent& event) {
+    // Skip '{'
+    ++pos;
+    while (pos < str.size()) {
+        skipSpace(str, pos);
+        if (pos >= str.size()) {
+            return;
+        }
+        if (str[pos] == '}') {
+            ++pos;
+            return;
+        }
+        if (str[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        std::string key = parseString(str, pos);
+        skipSpace(str, pos);
+        // Skip ':'
+        ++pos;
+        skipSpace(str, pos);
+
+        if (key == "name" && str[pos] == '"') {
+            event.name = parseString(str, pos);
+        } else if (key == "dur") {
+            event.dur = parseNumber(str, pos);
+        } else if (key == "args" && str[pos] == '{') {
+            // Nested object, only detail is used
+            TraceEvent args;
+            args.dur = 0;
+            parseEvent(str, pos, args);
+            event.detail = args.detail;
+        } else if (key == "detail" && str[pos] == '"') {
+            event.detail = parseString(str, pos);
+        } else {
+            skipValue(str, pos);
+        }
+    }
+}
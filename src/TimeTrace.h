@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <map>
+#include <ostream>
+
+namespace fs = std::filesystem;
+
+// Complete event of clang -ftime-trace
+struct TraceEvent {
+    std::string name;
+    std::string detail;
+    // Duration in microseconds
+    double dur;
+};
+
+class TimeTrace {
+public:
+    /**
+     * Read complete events from a -ftime-trace JSON file
+     * Returns empty if the file does not exist
+     */
+    static std::vector<TraceEvent> read(const fs::path& file);
+
+    /**
+     * Merge events of one TU, returns false if the file does not exist
+     */
+    bool add(const fs::path& file);
+
+    /**
+     * Write the most expensive items of each kind
+     */
+    void report(std::ostream& out, size_t top) const;
+
+    // Number of merged TUs
+    size_t count() const { return files; }
+
+private:
+    struct Stat {
+        size_t count = 0;
+        // Total duration in microseconds
+        double dur = 0;
+    };
+
+    // Event name to detail to stat
+    std::map<std::string, std::map<std::string, Stat>> stats;
+
+    // Phase totals, such as "Total Frontend"
+    std::map<std::string, Stat> totals;
+
+    size_t files = 0;
+
+    void reportKind(std::ostream& out, const std::string& title, const std::vector<std::string>& names, size_t top) const;
+
+    static void skipSpace(const std::string& str, size_t& pos);
+    static std::string parseString(const std::string& str, size_t& pos);
+    static double parseNumber(const std::string& str, size_t& pos);
+    static void skipValue(const std::string& str, size_t& pos);
+    static void parseEvent(const std::string& str, size_t& pos, TraceEvent& event);
+};
@@ -1,13 +1,26 @@
 #include "Utils.h"
+#include "Stats.h"
+#include "StatCache.h"
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
 
 #ifdef _WIN32
 #include <windows.h>
 #elif defined(__linux__)
 #include <unistd.h>
+#include <climits>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
 #elif defined(__APPLE__)
 #include <mach-o/dyld.h>
+#include <sys/clonefile.h>
 #endif
 
 
@@ -18,11 +31,13 @@ std::map<std::string, std::string> Utils::readProps(const fs::path& file) {
     if (!ifs.is_open()) {
         return props;
     }
+    Stats::count(Stats::fileRead);
 
     std::string line;
     std::string currentLine;
 
     while (std::getline(ifs, line)) {
+        Stats::count(Stats::bytesRead, line.size() + 1);
         // Trim whitespace from the end
         size_t end = line.find_last_not_of(" \t");
         if (end != std::string::npos) {
@@ -109,12 +124,14 @@ std::vector<std::string> Utils::split(const std::string& str, char delimiter) {
 }
 
 void Utils::loadConfigs(const fs::path& scriptDir, std::map<std::string, std::string>& configs, const char* file) {
-    
+    Stats::Phase phase("config");
+
     // Load config files in order of increasing priority
     // 1. Executable directory (lowest priority)
     fs::path exePath = Utils::exePath();
     if (!exePath.empty()) {
         fs::path configFile = exePath.parent_path() / file;
+        Stats::count(Stats::fileStat);
         if (fs::exists(configFile)) {
             auto configPropsMap = Utils::readProps(configFile);
             for (const auto& [k, v] : configPropsMap) {
@@ -125,6 +142,7 @@ void Utils::loadConfigs(const fs::path& scriptDir, std::map<std::string, std::st
     
     // 2. Script directory (highest priority)
     fs::path configFile = scriptDir / file;
+    Stats::count(Stats::fileStat);
     if (fs::exists(configFile)) {
         auto configPropsMap = Utils::readProps(configFile);
         for (const auto& [k, v] : configPropsMap) {
@@ -157,6 +175,29 @@ std::string Utils::exePath() {
     return exePath.generic_string();
 }
 
+fs::path Utils::findExe(const std::string& name) {
+    const char* pathEnv = std::getenv("PATH");
+    if (!pathEnv) {
+        return fs::path();
+    }
+#ifdef _WIN32
+    std::vector<std::string> dirs = split(pathEnv, ';');
+    std::string fileName = name + ".exe";
+#else
+    std::vector<std::string> dirs = split(pathEnv, ':');
+    std::string fileName = name;
+#endif
+    for (const auto& dir : dirs) {
+        if (dir.empty()) {
+            continue;
+        }
+        fs::path f = fs::path(dir) / fileName;
+        if (fs::exists(f) && fs::is_regular_file(f)) {
+            return f;
+        }
+    }
+    return fs::path();
+}
 
 void Utils::setenv(const char* key, const char* value) {
 #ifdef _WIN32
@@ -192,12 +233,14 @@ std::vector<IniSection> Utils::readIni(const fs::path& file) {
     if (!ifs.is_open()) {
         return iniData;
     }
+    Stats::count(Stats::fileRead);
 
     std::string line;
     std::string currentLine;
     IniSection currentSection;
 
     while (std::getline(ifs, line)) {
+        Stats::count(Stats::bytesRead, line.size() + 1);
 
         // Check if line ends with backslash
         if (!line.empty() && line.back() == '\\') {
@@ -268,3 +311,166 @@ std::vector<IniSection> Utils::readIni(const fs::path& file) {
 void Utils::throwError(const std::string& message) {
     throw std::runtime_error(message);
 }
+
+void Utils::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    // A thread is worth it for a few dozen syscalls
+    size_t threadCount = std::min<size_t>(std::thread::hardware_concurrency(), (count + 15) / 16);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                fn(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+#ifdef __linux__
+// Reflink or copy_file_range, false if neither works here
+static bool kernelCopy(const fs::path& src, const fs::path& dst) {
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        close(in);
+        return false;
+    }
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    bool ok = false;
+    if (ioctl(out, FICLONE, in) == 0) {
+        Stats::count(Stats::fileClone);
+        ok = true;
+    } else {
+        off_t left = st.st_size;
+        ok = true;
+        while (left > 0) {
+            ssize_t n = copy_file_range(in, nullptr, out, nullptr, (size_t)left, 0);
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            left -= n;
+        }
+        if (ok) {
+            Stats::count(Stats::fileCopy);
+        }
+    }
+    close(in);
+    close(out);
+    if (!ok) {
+        std::error_code ec;
+        fs::remove(dst, ec);
+    }
+    return ok;
+}
+#endif
+
+// Same bytes, for sources saved again without a real change
+static bool sameContent(const fs::path& a, const fs::path& b) {
+    std::ifstream fa(a, std::ios::binary);
+    std::ifstream fb(b, std::ios::binary);
+    std::vector<char> ba(64 * 1024);
+    std::vector<char> bb(ba.size());
+    while (fa && fb) {
+        fa.read(ba.data(), ba.size());
+        fb.read(bb.data(), bb.size());
+        if (fa.gcount() != fb.gcount() || memcmp(ba.data(), bb.data(), (size_t)fa.gcount()) != 0) {
+            return false;
+        }
+    }
+    return fa.eof() && fb.eof();
+}
+
+void Utils::installFile(const fs::path& src, const fs::path& dst, bool immutable) {
+    std::error_code ec;
+    Stats::count(Stats::fileStat, 2);
+    auto srcTime = fs::last_write_time(src);
+    if (fs::exists(fs::symlink_status(dst, ec))) {
+        if (fs::equivalent(src, dst, ec)) {
+            return;
+        }
+        if (fs::is_regular_file(dst, ec) && fs::file_size(dst, ec) == fs::file_size(src)) {
+            if (fs::last_write_time(dst, ec) == srcTime) {
+                return;
+            }
+            // Keep the older time of identical content, dependents don't rebuild
+            if (!immutable && sameContent(src, dst)) {
+                Stats::count(Stats::fileRead, 2);
+                return;
+            }
+        }
+        // Never write through, dst may be a hard link of an older output
+        fs::remove(dst);
+    }
+
+    if (immutable) {
+        fs::create_hard_link(src, dst, ec);
+        if (!ec) {
+            Stats::count(Stats::fileLink);
+            StatCache::forget({StatCache::key(dst)});
+            return;
+        }
+    }
+#if defined(__linux__)
+    if (!kernelCopy(src, dst))
+#elif defined(__APPLE__)
+    // APFS clone
+    if (clonefile(src.c_str(), dst.c_str(), 0) == 0) {
+        Stats::count(Stats::fileClone);
+    } else
+#endif
+    {
+        fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+        Stats::count(Stats::fileCopy);
+    }
+    // Same time as the source, the next install of an unchanged file is skipped
+    fs::last_write_time(dst, srcTime);
+    StatCache::forget({StatCache::key(dst)});
+}
+
+std::string Utils::readFile(const fs::path& file) {
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs) {
+        return std::string();
+    }
+    Stats::count(Stats::fileRead);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+bool Utils::writeIfChanged(const fs::path& file, const std::string& content) {
+    Stats::count(Stats::fileStat);
+    if (fs::exists(file) && readFile(file) == content) {
+        return false;
+    }
+
+    fs::path tmpFile = file.generic_string() + ".tmp";
+    std::ofstream ofs(tmpFile, std::ios::binary);
+    ofs << content;
+    ofs.close();
+    if (!ofs) {
+        throwError("Cannot write file: " + tmpFile.generic_string());
+    }
+    fs::rename(tmpFile, file);
+    StatCache::forget({StatCache::key(file)});
+    return true;
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <filesystem>
+#include <functional>
 
 namespace fs = std::filesystem;
 
@@ -33,6 +34,12 @@ public:
     static std::vector<std::string> split(const std::string& str, char delimiter);
 
     static std::string exePath();
+
+    /**
+     * Search executable in PATH, return empty if not found
+     */
+    static fs::path findExe(const std::string& name);
+
     static void setenv(const char* key, const char* value);
     
     /**
@@ -51,6 +58,30 @@ public:
      * Read INI file and return a vector of sections, each containing a map of key-value pairs
      */
     static std::vector<IniSection> readIni(const fs::path& file);
+
+    /**
+     * Run fn(0..count-1) on worker threads, small counts run inline.
+     * fn must not touch shared state such as Stats.
+     */
+    static void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    /**
+     * Install a file, skipped if dst already has the same size and time.
+     * Immutable build outputs are hard linked, others reflinked where the file system
+     * supports it, then copied in the kernel, then copied.
+     */
+    static void installFile(const fs::path& src, const fs::path& dst, bool immutable);
+
+    /**
+     * Content of a file, empty if it can't be read
+     */
+    static std::string readFile(const fs::path& file);
+
+    /**
+     * Replace a file through a temporary file if its content differs, an unchanged file keeps
+     * its time. Returns true if written.
+     */
+    static bool writeIfChanged(const fs::path& file, const std::string& content);
 private:
     /**
      * Trim whitespace from string
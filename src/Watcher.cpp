@@ -0,0 +1,188 @@
+#include "Watcher.h"
+#include <set>
+#include <thread>
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static int64_t modifyTime(const fs::path& path) {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return ec ? -1 : (int64_t)time.time_since_epoch().count();
+}
+
+Watcher::Watcher() : fd(-1) {
+#ifdef __linux__
+    fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+#endif
+}
+
+Watcher::~Watcher() {
+#ifdef __linux__
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+bool Watcher::watch(const std::vector<fs::path>& dirs, const std::vector<fs::path>& files) {
+    std::set<std::string> wanted;
+    for (const auto& dir : dirs) {
+        std::string key = dir.lexically_normal().generic_string();
+        while (key.size() > 1 && key.back() == '/') {
+            key.pop_back();
+        }
+        wanted.insert(key);
+    }
+
+#ifdef __linux__
+    if (fd >= 0) {
+        // Drop directories no longer needed
+        for (auto it = watchIds.begin(); it != watchIds.end();) {
+            if (wanted.find(it->first) == wanted.end()) {
+                inotify_rm_watch(fd, it->second);
+                watches.erase(it->second);
+                it = watchIds.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        bool all = true;
+        for (const auto& dir : wanted) {
+            if (watchIds.find(dir) != watchIds.end()) {
+                continue;
+            }
+            int wd = inotify_add_watch(fd, dir.c_str(),
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB);
+            if (wd >= 0) {
+                watches[wd] = dir;
+                watchIds[dir] = wd;
+            } else {
+                all = false;
+            }
+        }
+        return all;
+    }
+#endif
+
+    times.clear();
+    for (const auto& dir : wanted) {
+        times[dir] = modifyTime(dir);
+    }
+    for (const auto& file : files) {
+        times[file.lexically_normal().generic_string()] = modifyTime(file);
+    }
+    return true;
+}
+
+bool Watcher::readEvents(int timeoutMs, std::vector<Change>& changes) {
+#ifdef __linux__
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready <= 0) {
+        return false;
+    }
+
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    bool any = false;
+    while (true) {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            break;
+        }
+        for (char* p = buffer; p < buffer + len;) {
+            auto* event = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes.push_back(Change{fs::path(), lost});
+                any = true;
+                continue;
+            }
+            auto it = watches.find(event->wd);
+            if (it == watches.end() || event->len == 0) {
+                continue;
+            }
+            ChangeType type = modified;
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                type = added;
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                type = removed;
+            }
+            changes.push_back(Change{it->second / event->name, type});
+            any = true;
+        }
+    }
+    return any;
+#else
+    (void)timeoutMs;
+    (void)changes;
+    return false;
+#endif
+}
+
+bool Watcher::pollChanges(std::vector<Change>& changes) {
+    bool any = false;
+    for (auto& [path, time] : times) {
+        int64_t now = modifyTime(path);
+        if (now != time) {
+            ChangeType type = (time == -1) ? added : (now == -1 ? removed : modified);
+            // A directory changes when entries are added or removed
+            if (type == modified && fs::is_directory(path)) {
+                type = added;
+            }
+            changes.push_back(Change{path, type});
+            time = now;
+            any = true;
+        }
+    }
+    return any;
+}
+
+std::vector<Watcher::Change> Watcher::wait(int settleMs) {
+    std::vector<Change> changes;
+    if (fd >= 0) {
+        while (!readEvents(-1, changes)) {
+        }
+        // Coalesce the burst, an editor save is several events
+        while (readEvents(settleMs, changes)) {
+        }
+    } else {
+        while (!pollChanges(changes)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(settleMs));
+        pollChanges(changes);
+    }
+
+    return merge(changes);
+}
+
+std::vector<Watcher::Change> Watcher::pending() {
+    std::vector<Change> changes;
+    if (fd >= 0) {
+        readEvents(0, changes);
+    } else {
+        pollChanges(changes);
+    }
+    return merge(changes);
+}
+
+std::vector<Watcher::Change> Watcher::merge(const std::vector<Change>& changes) {
+    std::map<std::string, size_t> merged;
+    std::vector<Change> result;
+    for (const auto& change : changes) {
+        std::string key = change.path.generic_string();
+        auto it = merged.find(key);
+        if (it == merged.end()) {
+            merged[key] = result.size();
+            result.push_back(change);
+        } else if (change.type != modified) {
+            result[it->second].type = change.type;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Waits for file changes in a set of directories.
+// Uses inotify on Linux, other platforms poll the modify times.
+class Watcher {
+public:
+    enum ChangeType {
+        modified,
+        added,
+        removed,
+        // Events were dropped, anything may have changed
+        lost
+    };
+
+    struct Change {
+        fs::path path;
+        ChangeType type;
+    };
+
+    Watcher();
+    ~Watcher();
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    /**
+     * Replace the watched directories and files, files are only used by polling.
+     * False if a directory could not be watched.
+     */
+    bool watch(const std::vector<fs::path>& dirs, const std::vector<fs::path>& files);
+
+    /**
+     * True when the OS reports changes, false when changes are found by polling
+     */
+    bool notifies() const { return fd >= 0; }
+
+    /**
+     * Block until something changes, then wait until the burst of changes settles
+     */
+    std::vector<Change> wait(int settleMs = 30);
+
+    /**
+     * Changes reported so far, never blocks
+     */
+    std::vector<Change> pending();
+
+private:
+    int fd;
+    std::map<int, fs::path> watches;
+    std::map<std::string, int> watchIds;
+
+    // Polling state, modify time of every watched path
+    std::map<std::string, int64_t> times;
+
+    // Collect pending events, waits at most timeoutMs, -1 for ever
+    bool readEvents(int timeoutMs, std::vector<Change>& changes);
+    bool pollChanges(std::vector<Change>& changes);
+
+    // One change per path, added or removed wins over modified
+    static std::vector<Change> merge(const std::vector<Change>& changes);
+};
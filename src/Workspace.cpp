@@ -0,0 +1,139 @@
+#include "Workspace.h"
+#include "BuildCpp.h"
+#include "Stats.h"
+#include <fstream>
+#include <map>
+#include <set>
+#include <functional>
+#include <algorithm>
+
+void Workspace::load(const fs::path& file) {
+    Stats::Phase phase("script");
+    std::ifstream ifs(file);
+    if (!ifs) {
+        Utils::throwError("Cannot read workspace: " + file.generic_string());
+    }
+    Stats::count(Stats::fileRead);
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        line = line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin);
+        fs::path scriptFile = file.parent_path() / line;
+        if (fs::is_directory(scriptFile)) {
+            scriptFile /= "fmake.props";
+        }
+        if (!fs::exists(scriptFile)) {
+            Utils::throwError("Script file not found: " + scriptFile.generic_string());
+        }
+        scriptFile = fs::absolute(scriptFile).lexically_normal();
+
+        for (IniSection& section : Utils::readIni(scriptFile)) {
+            Pod pod;
+            pod.name = podName(section);
+            pod.depends = dependNames(section);
+            if (find(pod.name)) {
+                Utils::throwError("Pod " + pod.name + " is defined twice in the workspace");
+            }
+            pod.scriptFile = scriptFile;
+            pod.section = std::move(section);
+            pods.push_back(std::move(pod));
+        }
+    }
+}
+
+std::string Workspace::podName(const IniSection& section) {
+    auto it = section.props.find("name");
+    return it != section.props.end() ? it->second : section.name;
+}
+
+std::vector<std::string> Workspace::dependNames(const IniSection& section) {
+    // gcc.depends, win32.depends, ... may all apply, an extra edge only orders the build
+    std::vector<std::string> names;
+    for (const auto& [key, value] : section.props) {
+        if (key != "depends" && (key.size() < 8 || key.compare(key.size() - 8, 8, ".depends") != 0)) {
+            continue;
+        }
+        for (const auto& token : Utils::split(value, ',')) {
+            if (!token.empty()) {
+                names.push_back(Depend(token).name);
+            }
+        }
+    }
+    return names;
+}
+
+Workspace::Pod* Workspace::find(const std::string& name) {
+    for (Pod& pod : pods) {
+        if (pod.name == name) {
+            return &pod;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::vector<Workspace::Pod*>> Workspace::waves(const std::string& target) {
+    // Pods to build, depends outside the workspace come from the repo
+    std::vector<Pod*> todo;
+    if (target.empty()) {
+        for (Pod& pod : pods) {
+            todo.push_back(&pod);
+        }
+    } else {
+        Pod* root = find(target);
+        if (!root) {
+            Utils::throwError("Target not found in workspace: " + target);
+        }
+        std::set<Pod*> seen = {root};
+        todo.push_back(root);
+        for (size_t i = 0; i < todo.size(); ++i) {
+            for (const auto& dep : todo[i]->depends) {
+                Pod* pod = find(dep);
+                if (pod && seen.insert(pod).second) {
+                    todo.push_back(pod);
+                }
+            }
+        }
+    }
+
+    // Level of a pod is one more than its deepest depend
+    std::map<Pod*, int> levels;
+    std::vector<std::vector<Pod*>> result;
+    std::set<Pod*> visiting;
+    std::function<int(Pod*)> level = [&](Pod* pod) {
+        auto it = levels.find(pod);
+        if (it != levels.end()) {
+            return it->second;
+        }
+        if (!visiting.insert(pod).second) {
+            Utils::throwError("Depend cycle in workspace at " + pod->name);
+        }
+        int n = 0;
+        for (const auto& dep : pod->depends) {
+            Pod* depPod = find(dep);
+            if (depPod) {
+                n = std::max(n, level(depPod) + 1);
+            }
+        }
+        visiting.erase(pod);
+        levels[pod] = n;
+        return n;
+    };
+    for (Pod* pod : todo) {
+        int n = level(pod);
+        if ((int)result.size() <= n) {
+            result.resize(n + 1);
+        }
+    }
+    // Keep the order of the workspace file inside a wave
+    for (Pod& pod : pods) {
+        auto it = levels.find(&pod);
+        if (it != levels.end()) {
+            result[it->second].push_back(&pod);
+        }
+    }
+    return result;
+}
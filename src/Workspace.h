@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "Utils.h"
+
+namespace fs = std::filesystem;
+
+// Pods of several build scripts, built from source in dependency order
+class Workspace {
+public:
+    // One section of a member script
+    struct Pod {
+        std::string name;
+        fs::path scriptFile;
+        IniSection section;
+        // Names of depends, also those of other platforms and compilers
+        std::vector<std::string> depends;
+    };
+
+    std::vector<Pod> pods;
+
+    /**
+     * Read a workspace file, one script or script directory per line, relative to the file
+     */
+    void load(const fs::path& file);
+
+    /**
+     * Pods to build for a target and its transitive depends, or for every pod if the target
+     * is empty. Pods of a wave only depend on pods of earlier waves.
+     */
+    std::vector<std::vector<Pod*>> waves(const std::string& target);
+
+    /**
+     * Name of the pod a section builds
+     */
+    static std::string podName(const IniSection& section);
+
+    /**
+     * Names of the depends of a section, also those of other platforms and compilers
+     */
+    static std::vector<std::string> dependNames(const IniSection& section);
+
+private:
+    Pod* find(const std::string& name);
+};
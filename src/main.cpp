@@ -6,60 +6,312 @@
 #include "BuildCpp.h"
 #include "CompileCpp.h"
 #include "Generator.h"
+#include "Stats.h"
+#include "BuildCache.h"
+#include "StatCache.h"
+#include "Watcher.h"
+#include "Daemon.h"
+#include "Workspace.h"
+#include <memory>
+#include <set>
 
 namespace fs = std::filesystem;
 
+// Command line options applied to each target
+struct Options {
+    bool force = false;
+    bool checkError = true;
+    bool debug = false;
+    bool execute = false;
+    bool pgo = false;
+    bool layout = false;
+    bool timeTrace = false;
+    bool devLink = false;
+    std::string compiler;
+};
+
+// Target kept alive by -watch
+struct WatchTarget {
+    IniSection section;
+    Options options;
+    std::unique_ptr<BuildCpp> build;
+    std::unique_ptr<CompileCpp> cc;
+};
+
+// Parse a target, or load it from the parse cache
+static std::unique_ptr<BuildCpp> loadTarget(const Options& options, const fs::path& scriptFile, IniSection& section) {
+    auto build = std::make_unique<BuildCpp>();
+    if (options.debug) {
+        build->debug = "debug";
+    }
+    if (options.execute) {
+        build->execute = options.execute;
+    }
+    if (!options.compiler.empty()) {
+        build->compiler = options.compiler;
+    }
+    build->pgo = options.pgo;
+    build->layout = options.layout;
+    build->timeTrace = options.timeTrace;
+    build->devLink = options.devLink;
+
+    fs::path cacheFile = BuildCache::cacheFile(scriptFile, section, *build, options.checkError);
+    if (options.force || !BuildCache::load(cacheFile, *build)) {
+        build->parse(scriptFile, options.checkError, section);
+        BuildCache::save(cacheFile, *build);
+    }
+    return build;
+}
+
+static bool isCode(const fs::path& file) {
+    static const std::set<std::string> exts = {".cpp", ".c", ".cc", ".cxx", ".m", ".C", ".c++", ".h", ".hpp", ".inl"};
+    return exts.find(file.extension().generic_string()) != exts.end();
+}
+
+// Rebuild targets whenever their files change, never returns
+static void watchTargets(std::vector<WatchTarget>& targets, const fs::path& scriptFile) {
+    Watcher watcher;
+    while (true) {
+        // Files read by parse, a change needs a new parse
+        std::set<std::string> parseInputs = {StatCache::key(scriptFile)};
+        // Sources and headers, a change needs a compile
+        std::set<std::string> codeInputs;
+        std::set<std::string> dirSet = {StatCache::key(scriptFile.parent_path())};
+        std::vector<fs::path> files = {scriptFile};
+
+        for (auto& target : targets) {
+            for (const auto& input : target.build->inputs) {
+                if (fs::is_directory(input)) {
+                    dirSet.insert(StatCache::key(input));
+                } else {
+                    dirSet.insert(StatCache::key(input.parent_path()));
+                    parseInputs.insert(StatCache::key(input));
+                    files.push_back(input);
+                }
+            }
+            // Pods resolved through index.props never read meta.props, a reinstall still needs a new parse
+            for (const auto& dep : target.build->depends) {
+                fs::path meta = target.build->outHome / dep.name / "meta.props";
+                dirSet.insert(StatCache::key(meta.parent_path()));
+                parseInputs.insert(StatCache::key(meta));
+                files.push_back(meta);
+            }
+            for (const auto& file : target.cc->inputFiles()) {
+                dirSet.insert(StatCache::key(file.parent_path()));
+                codeInputs.insert(StatCache::key(file));
+                files.push_back(file);
+            }
+        }
+        std::vector<fs::path> dirs;
+        for (const auto& dir : dirSet) {
+            if (fs::is_directory(dir)) {
+                dirs.push_back(dir);
+            }
+        }
+        watcher.watch(dirs, files);
+        std::cout << "Watching " << dirs.size() << " directories, Ctrl+C to stop" << std::endl;
+
+        bool reparse = false;
+        std::vector<fs::path> changed;
+        while (!reparse && changed.empty()) {
+            for (const auto& change : watcher.wait()) {
+                std::string key = StatCache::key(change.path);
+                bool known = codeInputs.count(key) > 0;
+                // Editors save by rename, a known file that still exists was only modified
+                bool added = change.type == Watcher::added && !known;
+                bool removed = change.type == Watcher::removed && !fs::exists(change.path);
+                if (change.type == Watcher::lost || parseInputs.count(key) || ((added || removed) && isCode(change.path))) {
+                    reparse = true;
+                } else if (known) {
+                    changed.push_back(change.path);
+                } else {
+                    continue;
+                }
+                std::cout << "Changed " << change.path.generic_string() << std::endl;
+            }
+        }
+
+        std::vector<IniSection> sections;
+        if (reparse) {
+            StatCache::forget();
+            sections = Utils::readIni(scriptFile);
+        }
+        for (auto& target : targets) {
+            try {
+                if (reparse) {
+                    for (const auto& section : sections) {
+                        if (section.name == target.section.name) {
+                            target.section = section;
+                        }
+                    }
+                    target.cc.reset();
+                    target.build = loadTarget(target.options, scriptFile, target.section);
+                    target.cc = std::make_unique<CompileCpp>(*target.build);
+                    target.cc->run();
+                } else {
+                    target.cc->rerun(changed);
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                std::cout << "BUILD FAIL" << std::endl;
+            }
+        }
+    }
+}
+
 void printHelp() {
     std::cout << "Usage: fmake [options] [script_file]" << std::endl;
     std::cout << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "  -?, -help      Show this help message" << std::endl;
     std::cout << "  -f, -force     Force clean build" << std::endl;
-    std::cout << "  -G, -generate  Generate make files" << std::endl;
+    std::cout << "  -G, -generate  Generate make files, -G ninja writes build.ninja" << std::endl;
     std::cout << "  -dump          Dump build information" << std::endl;
     std::cout << "  -d, -debug     Enable debug mode" << std::endl;
     std::cout << "  -c, -compiler  Specify compiler" << std::endl;
+    std::cout << "  -configs       Build several compiler:mode configurations at once, e.g. gcc:debug,gcc:release" << std::endl;
     std::cout << "  -t, -target    Specify target name" << std::endl;
+    std::cout << "  -workspace     Build the pods of a workspace file in dependency order, -t builds one pod and its depends" << std::endl;
     std::cout << "  -execute       Execute the built binary" << std::endl;
+    std::cout << "  -pgo           Profile-guided optimization build" << std::endl;
+    std::cout << "  -layout        Optimize function layout after link" << std::endl;
+    std::cout << "  -analyze-includes  Report header cost" << std::endl;
+    std::cout << "  -analyze       Run clang-tidy or <compiler>.analyze over changed sources" << std::endl;
+    std::cout << "  -time-trace    Compile with -ftime-trace and merge the traces" << std::endl;
+    std::cout << "  -devlink       Debug builds link library pods as shared objects" << std::endl;
+    std::cout << "  -watch         Build again whenever sources, headers or the script change" << std::endl;
+    std::cout << "  -daemon        Serve builds of the workspace from memory, fmake forwards to it" << std::endl;
+    std::cout << "  -no-daemon     Build in this process even if a daemon is running" << std::endl;
+    std::cout << "  -stats         Print time and file access of fmake phases" << std::endl;
     std::cout << "  -version       Version information" << std::endl;
     std::cout << std::endl;
 }
 
-int main(int argc, char* argv[]) {
-    bool force = false;
+// Build the pods of a workspace wave by wave, the pods of a wave share one scheduler.
+// A wave waits for the whole previous one, parse resolves depends from the installed repo.
+static int buildWorkspace(const fs::path& file, const std::string& targetName, const std::vector<Options>& configs) {
+    Workspace workspace;
+    std::vector<std::vector<Workspace::Pod*>> waves;
+    std::cout << "Workspace " << file.generic_string() << std::endl;
+    try {
+        workspace.load(file);
+        waves = workspace.waves(targetName);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    for (const auto& wave : waves) {
+        std::vector<std::unique_ptr<BuildCpp>> builds;
+        std::vector<std::unique_ptr<CompileCpp>> ccs;
+        try {
+            for (Workspace::Pod* pod : wave) {
+                std::cout << "Target " << pod->name << " " << pod->scriptFile.generic_string() << std::endl;
+                for (const Options& config : configs) {
+                    builds.push_back(loadTarget(config, pod->scriptFile, pod->section));
+                    ccs.push_back(std::make_unique<CompileCpp>(*builds.back()));
+                    if (config.force) {
+                        ccs.back()->clean();
+                    }
+                }
+            }
+            std::vector<CompileCpp*> list;
+            for (auto& cc : ccs) {
+                list.push_back(cc.get());
+            }
+            CompileCpp::runAll(list);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            std::cout << "BUILD FAIL" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Run one command line, in this process or in the daemon
+static int runCommand(const std::vector<std::string>& args, bool inDaemon) {
+    Options options;
     bool generate = false;
+    bool ninja = false;
     bool dump = false;
-    bool debug = false;
-    bool execute = false;
-    std::string compiler;
+    bool analyzeIncludes = false;
+    bool analyze = false;
+    bool watch = false;
+    bool daemon = false;
+    bool noDaemon = false;
     std::string scriptPath;
     std::string targetName;
+    std::string configList;
+    std::string workspacePath;
 
     // Parse command line arguments
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
         if (arg == "-?" || arg == "-help") {
             printHelp();
             return 0;
         } else if (arg == "-f" || arg == "-force") {
-            force = true;
+            options.force = true;
         } else if (arg == "-G" || arg == "-generate") {
             generate = true;
+            if (i + 1 < args.size() && args[i + 1] == "ninja") {
+                ninja = true;
+                ++i;
+            }
         } else if (arg == "-dump") {
             dump = true;
         } else if (arg == "-d" || arg == "-debug") {
-            debug = true;
+            options.debug = true;
         } else if (arg == "-c" || arg == "-compiler") {
-            if (i + 1 < argc) {
-                compiler = argv[++i];
+            if (i + 1 < args.size()) {
+                options.compiler = args[++i];
+            }
+        } else if (arg == "-configs") {
+            if (i + 1 < args.size()) {
+                configList = args[++i];
+            }
+        } else if (arg == "-workspace") {
+            if (i + 1 < args.size()) {
+                workspacePath = args[++i];
             }
         } else if (arg == "-t" || arg == "-target") {
-            if (i + 1 < argc) {
-                targetName = argv[++i];
+            if (i + 1 < args.size()) {
+                targetName = args[++i];
             }
         }
         else if (arg == "-execute") {
-            execute = true;
+            options.execute = true;
+        }
+        else if (arg == "-pgo") {
+            options.pgo = true;
+        }
+        else if (arg == "-layout") {
+            options.layout = true;
+        }
+        else if (arg == "-analyze-includes") {
+            analyzeIncludes = true;
+        }
+        else if (arg == "-analyze") {
+            analyze = true;
+        }
+        else if (arg == "-time-trace") {
+            options.timeTrace = true;
+        }
+        else if (arg == "-devlink") {
+            options.devLink = true;
+        }
+        else if (arg == "-watch") {
+            watch = true;
+        }
+        else if (arg == "-daemon") {
+            daemon = true;
+        }
+        else if (arg == "-no-daemon") {
+            noDaemon = true;
+        }
+        else if (arg == "-stats") {
+            Stats::enabled = true;
         }
         else if (arg == "-version") {
             printf("fmake 4.0\n");
@@ -70,6 +322,15 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!workspacePath.empty()) {
+        if (generate || dump || analyzeIncludes || analyze || watch) {
+            std::cerr << "Error: -workspace only builds, it can't be used with -G, -dump, -analyze, -analyze-includes or -watch" << std::endl;
+            return 1;
+        }
+        // The daemon of the workspace file's directory serves it
+        scriptPath = workspacePath;
+    }
+
     if (scriptPath.size() == 0) {
         printHelp();
         return 1;
@@ -82,55 +343,189 @@ int main(int argc, char* argv[]) {
     }
     scriptFile = fs::absolute(scriptFile);
 
+    if (daemon || watch) {
+        if (inDaemon) {
+            std::cerr << "Error: -daemon and -watch can't run in the daemon, use -no-daemon" << std::endl;
+            return 1;
+        }
+        if (daemon) {
+            return Daemon::serve(scriptFile, [](const std::vector<std::string>& args) {
+                return runCommand(args, true);
+            });
+        }
+    } else if (!inDaemon && !noDaemon) {
+        int status = 0;
+        if (Daemon::forward(scriptFile, args, status)) {
+            return status;
+        }
+    }
+
+    options.checkError = !generate && !dump;
+
+    // One set of options per compiler:mode, all built by one scheduler
+    std::vector<Options> configs;
+    for (const std::string& item : Utils::split(configList, ',')) {
+        Options config = options;
+        size_t pos = item.find(':');
+        if (pos == std::string::npos) {
+            config.compiler = item;
+        } else {
+            config.compiler = item.substr(0, pos);
+            std::string mode = item.substr(pos + 1);
+            if (mode != "debug" && mode != "release") {
+                std::cerr << "Error: Unknown mode in -configs: " << item << std::endl;
+                return 1;
+            }
+            config.debug = mode == "debug";
+        }
+        configs.push_back(config);
+    }
+    if (configs.empty()) {
+        configs.push_back(options);
+    }
+
+    if (!workspacePath.empty()) {
+        int status = buildWorkspace(scriptFile, targetName, configs);
+        Stats::print(std::cout);
+        return status;
+    }
+
     std::cout << "Input " << scriptFile.generic_string() << std::endl;
-    std::vector<IniSection> sections = Utils::readIni(scriptFile);
+    std::vector<IniSection> sections;
+    {
+        Stats::Phase phase("script");
+        sections = Utils::readIni(scriptFile);
+    }
+
+    std::vector<WatchTarget> watched;
+    // Sections are parsed one by one, their cmake projects configure in parallel
+    std::vector<std::unique_ptr<BuildCpp>> generated;
+    std::vector<std::unique_ptr<Generator>> generators;
+    // Sections build together, so a TU they share compiles once, until one depends on another
+    std::vector<WatchTarget> pending;
+    std::set<std::string> pendingPods;
+    auto flush = [&]() {
+        if (pending.empty()) {
+            return true;
+        }
+        std::vector<CompileCpp*> list;
+        for (auto& target : pending) {
+            list.push_back(target.cc.get());
+        }
+        bool ok = true;
+        try {
+            if (analyze) {
+                CompileCpp::analyzeAll(list);
+            } else {
+                CompileCpp::runAll(list);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            std::cout << "BUILD FAIL" << std::endl;
+            ok = false;
+        }
+        if (watch && !analyze) {
+            for (auto& target : pending) {
+                target.options.force = false;
+                watched.push_back(std::move(target));
+            }
+            // Keep watching, the next save may fix it
+            ok = true;
+        }
+        pending.clear();
+        pendingPods.clear();
+        return ok;
+    };
 
     int count = 0;
     for (IniSection& section : sections) {
         if (!targetName.empty() && section.name != targetName) {
             continue;
         }
-        if (section.name.size() > 0) {
-            std::cout << "Target " << section.name << std::endl;
-        }
         count++;
-        
-        BuildCpp build;
-        if (debug) {
-            build.debug = "debug";
-        }
-        if (execute) {
-            build.execute = execute;
+
+        // A depend must be installed before the section is parsed
+        for (const auto& name : Workspace::dependNames(section)) {
+            if (pendingPods.count(name)) {
+                if (!flush()) {
+                    Stats::print(std::cout);
+                    return 1;
+                }
+                break;
+            }
         }
-        if (!compiler.empty()) {
-            build.compiler = compiler;
+        if (section.name.size() > 0) {
+            std::cout << "Target " << section.name << std::endl;
         }
 
         try {
-            build.parse(scriptFile, !generate && !dump, section);
+            for (const Options& config : configs) {
+                std::unique_ptr<BuildCpp> build = loadTarget(config, scriptFile, section);
 
-            if (generate) {
-                Generator generator(build);
-                generator.run(force);
-            } else if (dump) {
-                build.dump();
-            } else {
-                CompileCpp cc(build);
-                if (force) {
-                    cc.clean();
+                if (generate) {
+                    if (ninja) {
+                        Generator generator(*build);
+                        generator.runNinja(config.force, scriptFile, section.name);
+                    } else {
+                        generators.push_back(std::make_unique<Generator>(*build));
+                        generated.push_back(std::move(build));
+                    }
+                } else if (dump) {
+                    build->dump();
+                } else if (analyzeIncludes) {
+                    CompileCpp analyzer(*build);
+                    analyzer.analyzeIncludes();
+                } else {
+                    auto cc = std::make_unique<CompileCpp>(*build);
+                    if (config.force) {
+                        cc->clean();
+                    }
+                    pending.push_back(WatchTarget{section, config, std::move(build), std::move(cc)});
+                    pendingPods.insert(Workspace::podName(section));
                 }
-                cc.run();
             }
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
             std::cout << "BUILD FAIL" << std::endl;
+            // Keep watching, the next save may fix it
+            if (!watch || analyze || (pending.empty() && watched.empty())) {
+                Stats::print(std::cout);
+                return 1;
+            }
+        }
+    }
+    if (!flush()) {
+        Stats::print(std::cout);
+        return 1;
+    }
+
+    if (!generators.empty()) {
+        std::vector<Generator*> list;
+        for (auto& generator : generators) {
+            list.push_back(generator.get());
+        }
+        try {
+            Generator::runAll(list, options.force);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            Stats::print(std::cout);
             return 1;
         }
     }
 
+    if (!watched.empty()) {
+        watchTargets(watched, scriptFile);
+    }
+
+    Stats::print(std::cout);
+
     if (count == 0 && !targetName.empty()) {
         std::cerr << "Error: Target not found: " << targetName << std::endl;
         return 1;
     }
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    return runCommand(std::vector<std::string>(argv + 1, argv + argc), false);
+}
@@ -0,0 +1,23 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#define SLOTS 65536
+static void* seen[SLOTS];
+static FILE* out;
+__attribute__((no_instrument_function)) void __cyg_profile_func_enter(void* fn, void* site) {
+    (void)site;
+    unsigned long h = ((unsigned long)fn >> 4) % SLOTS;
+    for (int i = 0; i < SLOTS; ++i, h = (h + 1) % SLOTS) {
+        void* cur = __atomic_load_n(&seen[h], __ATOMIC_ACQUIRE);
+        if (cur == fn) return;
+        if (cur == 0 && __atomic_compare_exchange_n(&seen[h], &cur, fn, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;
+        if (cur == fn) return;
+    }
+    Dl_info info;
+    if (!dladdr(fn, &info) || !info.dli_sname) return;
+    if (!out) out = fopen("/root/repo/test/cppExe/../build/layout-helloExe-gcc/order.raw", "a");
+    if (out) fprintf(out, "%s\n", info.dli_sname);
+}
+__attribute__((no_instrument_function)) void __cyg_profile_func_exit(void* fn, void* site) {
+    (void)fn; (void)site;
+}
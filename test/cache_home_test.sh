@@ -0,0 +1,27 @@
+#!/bin/sh
+# The parse cache must not reuse the package repository of another HOME
+#
+# Usage: sh test/cache_home_test.sh [fmake binary]
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FMAKE=${1:-"$ROOT/bin/fmake"}
+WS=$(mktemp -d)
+trap 'rm -rf "$WS"' EXIT
+
+# Copy of test/cppLib with its own ../build
+cp -r "$ROOT/test/cppLib" "$WS/cppLib"
+mkdir -p "$WS/home1/fmakeRepo" "$WS/home2/fmakeRepo"
+unset FMAKE_REPO USERPROFILE
+cd "$WS/cppLib" || exit 1
+
+# The second run saves a snapshot whose inputs, index.props included, stay valid
+HOME="$WS/home1" "$FMAKE" -no-daemon fmake.props > "$WS/run1.txt" 2>&1 || { cat "$WS/run1.txt"; exit 1; }
+HOME="$WS/home1" "$FMAKE" -no-daemon fmake.props > "$WS/run1.txt" 2>&1 || { cat "$WS/run1.txt"; exit 1; }
+HOME="$WS/home2" "$FMAKE" -no-daemon fmake.props > "$WS/run2.txt" 2>&1 || { cat "$WS/run2.txt"; exit 1; }
+
+if [ -z "$(find "$WS/home2/fmakeRepo" -name meta.props)" ]; then
+  echo "FAIL: the run with a new HOME did not install into HOME=$WS/home2"
+  cat "$WS/run2.txt"
+  exit 1
+fi
+echo "PASS"